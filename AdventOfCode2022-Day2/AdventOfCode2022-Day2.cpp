@@ -13,116 +13,122 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <map>
 
 using namespace std;
 
-struct Move {
-    char myMove;
-    int score;
+/**
+ * Count of rounds in the strategy guide, bucketed by opponent move (A, B, C)
+ * and guide column (X, Y, Z). The guide only has nine distinct kinds of
+ * round, so once this is built any scoring rules can be applied in nine
+ * multiplies without re-reading the file.
+ */
+struct GuideHistogram {
+    long long counts[3][3] = { };
 };
 
 /**
- * Part 1: Calculates the total score by reading the strategy guide and
- * computing the score based on the predetermined outcomes and the scores
- * associated with each shape.
+ * Score awarded for one round, indexed by opponent move (A, B, C) and guide
+ * column (X, Y, Z). Each scoring variant is just a different table.
  */
-void day2_part1()
+struct ScoreTable {
+    int score[3][3];
+};
+
+/**
+ * Reads the strategy guide once and builds the round histogram. Lines that
+ * aren't of the form "<A-C> <X-Z>" are skipped.
+ */
+GuideHistogram loadGuide(const string& filename)
 {
-    std::ifstream invFile;
+    GuideHistogram hist;
+    ifstream invFile;
     string s;
 
-    map<char, int>shapeScores = {
-        { 'X', 1 },
-        { 'Y', 2 },
-        { 'Z', 3 },
-    };
+    invFile.open(filename);
+    while (std::getline(invFile, s)) {
+        if (s.length() < 3)
+            continue;
+
+        int om = s[0] - 'A';
+        int col = s[2] - 'X';
+        if (om < 0 || om > 2 || col < 0 || col > 2)
+            continue;
 
+        ++hist.counts[om][col];
+    }
 
-    // Opponent: A = Rock, B = Paper, C = Scissors
-    // Me: X = Rock, Y = Paper, Z = Scissors
-    map<string, int> winScores = {
-        { "AX", 3 },
-        { "AY", 6 },
-        { "AZ", 0 },
-        { "BX", 0 },
-        { "BY", 3 },
-        { "BZ", 6 },
-        { "CX", 6 },
-        { "CY", 0 },
-        { "CZ", 3 },
-    };
-
-
-    invFile.open("rps_strategy.txt");
-    int totalScore = 0;
-    while (std::getline(invFile, s)) {
-        char om = s[0];
-        char mm = s[2];
-        string key = "";
-        key = key + om + mm;
-        cout << key << endl;
-        
-        int score = shapeScores[mm] + winScores[key];
-        totalScore += score;
-
-        //cout << s.length() << endl;
-        //cout << s << ": score is " << score << endl;
+    return hist;
+}
+
+/**
+ * Scores the whole guide under one scoring table, O(9) regardless of how
+ * many rounds the guide has.
+ */
+long long scoreGuide(const GuideHistogram& hist, const ScoreTable& table)
+{
+    long long total = 0;
+    for (int om = 0; om < 3; ++om) {
+        for (int col = 0; col < 3; ++col) {
+            total += hist.counts[om][col] * table.score[om][col];
+        }
+    }
+    return total;
+}
+
+/**
+ * Scores the guide under each of a list of scoring tables.
+ */
+vector<long long> scoreGuide(const GuideHistogram& hist, const vector<ScoreTable>& tables)
+{
+    vector<long long> totals;
+    totals.reserve(tables.size());
+    for (const ScoreTable& table : tables) {
+        totals.push_back(scoreGuide(hist, table));
     }
-    cout << "total score is " << totalScore << endl;
+    return totals;
+}
+
+/**
+ * Part 1: Calculates the total score by reading the strategy guide and
+ * computing the score based on the predetermined outcomes and the scores
+ * associated with each shape.
+ */
+void day2_part1()
+{
+    // Opponent: A = Rock, B = Paper, C = Scissors
+    // Me: X = Rock (1), Y = Paper (2), Z = Scissors (3)
+    // Outcome: lose = 0, draw = 3, win = 6
+    const ScoreTable table = { {
+        //  X      Y      Z
+        { 1 + 3, 2 + 6, 3 + 0 },   // A
+        { 1 + 0, 2 + 3, 3 + 6 },   // B
+        { 1 + 6, 2 + 0, 3 + 3 },   // C
+    } };
+
+    GuideHistogram hist = loadGuide("rps_strategy.txt");
+    cout << "total score is " << scoreGuide(hist, table) << endl;
 }
 
 /**
  * Part 2: Calculates the total score, but the strategy guide is interpreted
  * differently: it specifies the desired outcome of each round (win, lose,
- * draw). The method determines the appropriate move to achieve this
- * outcome and calculates the score accordingly.
+ * draw). The table folds in the move needed to achieve that outcome, so
+ * scoring is the same histogram lookup as part 1.
  */
 void day2_part2()
 {
-    std::ifstream invFile;
-    string s;
-
-    map<char, int>shapeScores = {
-        { 'A', 1 },
-        { 'B', 2 },
-        { 'C', 3 },
-    };
-
     // Opponent: A = Rock, B = Paper, C = Scissors
     // Me: X = must lose, Y = must draw, Z = must win
-    map<string, Move> winScores = {
-        { "AX", { 'C', 0 } },
-        { "AY", { 'A', 3 } },
-        { "AZ", { 'B', 6 } },
-        { "BX", { 'A', 0 } },
-        { "BY", { 'B', 3 } },
-        { "BZ", { 'C', 6 } },
-        { "CX", { 'B', 0 } },
-        { "CY", { 'C', 3 } },
-        { "CZ", { 'A', 6 } },
-    };
-
-    invFile.open("rps_strategy.txt");
-    int totalScore = 0;
-    while (std::getline(invFile, s)) {
-        char om = s[0];
-        char end = s[2];
-        //char mm = winSel[om].myMove;
-        //cout << "end: " << end << ", mm: " << mm << endl;
-
-        string key = "";
-        key = key + om + end;
-        cout << key << endl;
-
-        char mm = winScores[key].myMove;
-        int score = shapeScores[mm] + winScores[key].score;
-        totalScore += score;
-
-        //cout << s.length() << endl;
-        cout << s << ": om=" << om << ", end = " << end << ", mm=" << mm <<", score is " << score << endl;
-    }
-    cout << "total score is " << totalScore << endl;
+    // Score is the shape I must play plus the outcome.
+    const ScoreTable table = { {
+        //  X      Y      Z
+        { 3 + 0, 1 + 3, 2 + 6 },   // A: play C, A, B
+        { 1 + 0, 2 + 3, 3 + 6 },   // B: play A, B, C
+        { 2 + 0, 3 + 3, 1 + 6 },   // C: play B, C, A
+    } };
+
+    GuideHistogram hist = loadGuide("rps_strategy.txt");
+    cout << "total score is " << scoreGuide(hist, table) << endl;
 }
 
 int main()
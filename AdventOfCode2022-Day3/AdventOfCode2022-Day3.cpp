@@ -13,21 +13,24 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <random>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-struct Move {
-    char myMove;
-    int score;
-};
-
+/**
+ * Converts an item letter to its priority: a-z are 1-26, A-Z are 27-52.
+ * Anything else is 0.
+ */
 int cvtToPriority(char c)
-    /**
-     * Part 2: This method reads groups of three lines (representing three Elves' rucksacks) from a file
-     * and identifies the badge item type common to all three rucksacks in each group. It calculates the
-     * sum of the priorities of these badge item types.
-     */
 {
     if (c >= 'a' && c <= 'z') {
         return 1 + c - 'a';
@@ -38,6 +41,238 @@ int cvtToPriority(char c)
     return 0;
 }
 
+char priorityToItem(int priority)
+{
+    return priority <= 26 ? 'a' + priority - 1 : 'A' + priority - 27;
+}
+
+/**
+ * Index of the lowest set bit. Mask must be non-zero.
+ */
+inline int lowestBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long idx;
+    _BitScanForward64(&idx, mask);
+    return (int)idx;
+#elif defined(_MSC_VER)
+    // 32-bit targets only have the 32-bit scan.
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long)mask))
+        return (int)idx;
+    _BitScanForward(&idx, (unsigned long)(mask >> 32));
+    return (int)idx + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+const uint64_t ITEM_BITS = ((1ull << 53) - 1) & ~1ull;
+
+/**
+ * Item masks have bit N set if an item of priority N is present, so bits
+ * 1-52 are used and the lowest set bit of a mask is directly a priority.
+ * Bit 0 collects anything that isn't an item letter and is cleared.
+ */
+uint64_t itemMaskScalar(const char* items, size_t len)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < len; ++i) {
+        mask |= 1ull << cvtToPriority(items[i]);
+    }
+    return mask & ITEM_BITS;
+}
+
+#ifdef __AVX2__
+/**
+ * Vector version of itemMaskScalar, 16 items per iteration. The high nibble
+ * of each letter selects how much to subtract to get its priority (0x26 for
+ * A-Z, 0x60 for a-z), which is a 16-entry cvtToPriority table held in a
+ * register and looked up with a byte shuffle. That table alone would give
+ * '@' and '{' through DEL letter priorities, so a range check on the byte
+ * with the case bit set picks out real letters and everything else gets
+ * 0x80 OR'd in. Priorities are then widened four at a time to 64-bit lanes
+ * and turned into bits with a variable shift, where anything of 64 or more
+ * shifts out, so the result always matches itemMaskScalar.
+ */
+uint64_t itemMask(const char* items, size_t len)
+{
+    const __m128i offsetLut = _mm_setr_epi8(
+        (char)0x80, (char)0x80, (char)0x80, (char)0x80, 0x26, 0x26, 0x60, 0x60,
+        (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80);
+    const __m128i loNibble = _mm_set1_epi8(0x0f);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i beforeA = _mm_set1_epi8('a' - 1);
+    const __m128i afterZ = _mm_set1_epi8('z' + 1);
+    const __m128i notItem = _mm_set1_epi8((char)0x80);
+    const __m256i one = _mm256_set1_epi64x(1);
+    __m256i acc = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(chunk, 4), loNibble);
+        __m128i pri = _mm_sub_epi8(chunk, _mm_shuffle_epi8(offsetLut, hi));
+
+        // Signed compares, so bytes from 0x80 up fail the range check too
+        __m128i folded = _mm_or_si128(chunk, caseBit);
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(folded, beforeA), _mm_cmpgt_epi8(afterZ, folded));
+        pri = _mm_or_si128(pri, _mm_andnot_si128(letter, notItem));
+
+        acc = _mm256_or_si256(acc, _mm256_sllv_epi64(one, _mm256_cvtepu8_epi64(pri)));
+        acc = _mm256_or_si256(acc, _mm256_sllv_epi64(one, _mm256_cvtepu8_epi64(_mm_srli_si128(pri, 4))));
+        acc = _mm256_or_si256(acc, _mm256_sllv_epi64(one, _mm256_cvtepu8_epi64(_mm_srli_si128(pri, 8))));
+        acc = _mm256_or_si256(acc, _mm256_sllv_epi64(one, _mm256_cvtepu8_epi64(_mm_srli_si128(pri, 12))));
+    }
+
+    __m128i acc2 = _mm_or_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    uint64_t mask = (uint64_t)_mm_cvtsi128_si64(acc2) | (uint64_t)_mm_extract_epi64(acc2, 1);
+
+    return (mask | itemMaskScalar(items + i, len - i)) & ITEM_BITS;
+}
+#else
+uint64_t itemMask(const char* items, size_t len)
+{
+    return itemMaskScalar(items, len);
+}
+#endif
+
+/**
+ * Sum of the priorities of every item in the mask.
+ */
+int maskPriority(uint64_t mask)
+{
+    int total = 0;
+    while (mask != 0) {
+        total += lowestBit(mask);
+        mask &= mask - 1;
+    }
+    return total;
+}
+
+/**
+ * Items in the mask as a string of item letters, lowest priority first.
+ */
+string maskItems(uint64_t mask)
+{
+    string items;
+    while (mask != 0) {
+        items += priorityToItem(lowestBit(mask));
+        mask &= mask - 1;
+    }
+    return items;
+}
+
+struct Line {
+    const char* text;
+    size_t len;
+};
+
+/**
+ * Reads the whole file into one buffer, so lines can be scanned in place
+ * without a string per rucksack.
+ */
+string readFile(const string& filename)
+{
+    ifstream in(filename, ios::binary);
+    string buf;
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    if (size <= 0)
+        return buf;
+    buf.resize((size_t)size);
+    in.seekg(0, ios::beg);
+    in.read(&buf[0], size);
+    return buf;
+}
+
+/**
+ * Splits the buffer into lines, dropping newlines (and any trailing '\r').
+ */
+vector<Line> splitLines(const string& buf)
+{
+    vector<Line> lines;
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    while (p < end) {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        if (nl == nullptr)
+            nl = end;
+        size_t len = nl - p;
+        if (len > 0 && p[len - 1] == '\r')
+            --len;
+        lines.push_back({ p, len });
+        p = nl + 1;
+    }
+    return lines;
+}
+
+/**
+ * Runs work(first, last) over [0, count) split into contiguous ranges, one
+ * per thread. Small jobs aren't worth the thread startup and run inline.
+ */
+template <typename Work>
+void runParallel(size_t count, int numThreads, Work work)
+{
+    const size_t minPerThread = 16384;
+    size_t threads = min((size_t)max(numThreads, 1), max(count / minPerThread, (size_t)1));
+    if (threads == 1) {
+        work((size_t)0, count);
+        return;
+    }
+
+    vector<thread> pool;
+    size_t per = (count + threads - 1) / threads;
+    for (size_t first = 0; first < count; first += per) {
+        size_t last = min(first + per, count);
+        pool.emplace_back(work, first, last);
+    }
+    for (thread& t : pool) {
+        t.join();
+    }
+}
+
+int defaultThreads()
+{
+    return max((int)thread::hardware_concurrency(), 1);
+}
+
+/**
+ * For each rucksack, the mask of items that appear in both compartments.
+ */
+vector<uint64_t> findMisplaced(const vector<Line>& sacks, int numThreads = defaultThreads())
+{
+    vector<uint64_t> common(sacks.size());
+    runParallel(sacks.size(), numThreads, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            size_t compLen = sacks[i].len / 2;
+            common[i] = itemMask(sacks[i].text, compLen) & itemMask(sacks[i].text + compLen, compLen);
+        }
+    });
+    return common;
+}
+
+/**
+ * For each group of groupSize consecutive rucksacks, the mask of items that
+ * appear in every rucksack of the group. A trailing partial group is ignored.
+ * Threads are handed whole groups, so a split never lands inside a group.
+ */
+vector<uint64_t> findBadges(const vector<Line>& sacks, int groupSize, int numThreads = defaultThreads())
+{
+    vector<uint64_t> common(sacks.size() / groupSize);
+    runParallel(common.size(), numThreads, [&](size_t first, size_t last) {
+        for (size_t g = first; g < last; ++g) {
+            uint64_t mask = ~0ull;
+            for (int i = 0; i < groupSize; ++i) {
+                const Line& sack = sacks[g * groupSize + i];
+                mask &= itemMask(sack.text, sack.len);
+            }
+            common[g] = mask;
+        }
+    });
+    return common;
+}
+
 /**
  * Part 1: This method reads the content of rucksacks from a file and
  * identifies the item type that appears in both compartments of each
@@ -45,27 +280,12 @@ int cvtToPriority(char c)
  */
 void day3_part1()
 {
-    std::ifstream invFile;
-    string s;
-
-    invFile.open("rucksack.txt");
-    int totalPriority = 0;
-    while (std::getline(invFile, s)) {
-        int compLen = s.length() / 2;
-        string comp1 = s.substr(0, compLen);
-        string comp2 = s.substr(compLen, compLen);
-        cout << comp1 << " : " << comp2 << endl;
-
-        for (int i = 0; i < compLen; ++i) {
-            char c = comp1[i];
-            int pos = comp2.find(c);
-            if (pos != string::npos) {
-                int priority = cvtToPriority(c);
-                cout << "    bad: " << c << " : " << priority << endl;
-                totalPriority += priority;
-                break;
-            }
-        }
+    string buf = readFile("rucksack.txt");
+    vector<Line> sacks = splitLines(buf);
+
+    long long totalPriority = 0;
+    for (uint64_t common : findMisplaced(sacks)) {
+        totalPriority += maskPriority(common);
     }
 
     cout << "total priority is " << totalPriority << endl;
@@ -73,45 +293,53 @@ void day3_part1()
 
 /**
  * Part 2: This method reads groups of three lines (representing three Elves'
- * rucksacks) from a file and identifies the badge item type common to all
+ * rucksacks) from a file and identifies the badge item types common to all
  * three rucksacks in each group. It calculates the sum of the priorities
  * of these badge item types.
  */
-void day3_part2()
-{
-    std::ifstream invFile;
-    string s1,s2,s3;
-
-    invFile.open("rucksack.txt");
-    int totalPriority = 0;
-    while (std::getline(invFile, s1)) {
-        std::getline(invFile, s2);
-        std::getline(invFile, s3);
-
-        int len = s1.length();
-
-        int flag = 0;
-        for (int i = 0; i < len; ++i) {
-            char c = s1[i];
-            int pos2 = s2.find(c);
-            int pos3 = s3.find(c);
-            if (pos2 != string::npos && pos3 != string::npos) {
-                int priority = cvtToPriority(c);
-                cout << "    bad: " << c << " : " << priority << endl;
-                totalPriority += priority;
-                flag = 1;
-                break;
-            }
+void day3_part2(int groupSize = 3)
+{
+    string buf = readFile("rucksack.txt");
+    vector<Line> sacks = splitLines(buf);
+    vector<uint64_t> badges = findBadges(sacks, groupSize);
+
+    long long totalPriority = 0;
+    for (size_t g = 0; g < badges.size(); ++g) {
+        if (badges[g] == 0) {
+            cout << "group " << g << ": NOT FOUND" << endl;
+            continue;
         }
-        if (!flag) {
-            cout << "NOT FOUND";
-            exit(0);
+        if ((badges[g] & (badges[g] - 1)) != 0) {
+            cout << "group " << g << ": multiple badges " << maskItems(badges[g]) << endl;
         }
-
+        totalPriority += maskPriority(badges[g]);
     }
+
     cout << "total priority is " << totalPriority << endl;
 }
 
+/**
+ * Cross-checks itemMask against itemMaskScalar on numLines random lines of
+ * printable bytes, DEL and high bytes, which is where a vector lookup can
+ * drift from cvtToPriority. Prints the mismatch count; without AVX2 both
+ * are the same function.
+ */
+void day3_check(int numLines)
+{
+    mt19937 rng(2022);
+    string line;
+    int mismatches = 0;
+    for (int n = 0; n < numLines; ++n) {
+        line.resize(1 + rng() % 64);
+        for (char& c : line) {
+            c = (char)(rng() % 8 == 0 ? 0x7f + rng() % 0x81 : ' ' + rng() % 0x5f);
+        }
+        if (itemMask(line.data(), line.length()) != itemMaskScalar(line.data(), line.length()))
+            ++mismatches;
+    }
+    cout << mismatches << " mismatches in " << numLines << " lines" << endl;
+}
+
 int main()
 {
     day3_part2();
@@ -14,119 +14,350 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <map>
-#include <regex>
+#include <cstdint>
+#include <climits>
 
 using namespace std;
 
-struct Move {
-    char myMove;
-    int score;
+/**
+ * Assignment pairs stored as one column per endpoint, so the predicates
+ * below are straight loops over contiguous int64 arrays.
+ */
+struct Assignments {
+    vector<int64_t> elf1Start;
+    vector<int64_t> elf1End;
+    vector<int64_t> elf2Start;
+    vector<int64_t> elf2End;
+
+    size_t size() const
+    {
+        return elf1Start.size();
+    }
 };
 
-std::vector<std::string> str_split(const std::string& s, const char *pattern) {
-    std::regex sep_regex = std::regex{ pattern };
-    std::sregex_token_iterator iter(s.begin(), s.end(), sep_regex, -1);
-    std::sregex_token_iterator end;
-    return { iter, end };
+string readFile(const string& filename)
+{
+    ifstream in(filename, ios::binary);
+    string buf;
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    if (size <= 0)
+        return buf;
+    buf.resize((size_t)size);
+    in.seekg(0, ios::beg);
+    in.read(&buf[0], size);
+    return buf;
 }
 
 /**
- * Part 1: Determines how many assignment pairs have one range that fully
- * contains the other. It reads each line from the file, splits it into two
- * ranges for each elf, and checks if one range is fully contained within
- * the other.
+ * Parses an unsigned decimal number at p, advancing p past it. Returns false
+ * if there are no digits.
  */
-void day4_part1()
+inline bool parseNum(const char*& p, const char* end, int64_t& value)
+{
+    const char* start = p;
+    int64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        ++p;
+    }
+    value = v;
+    return p != start;
+}
+
+inline bool expect(const char*& p, const char* end, char c)
 {
-    std::ifstream invFile;
-    string s;
-
-    invFile.open("elf_ranges.txt");
-    int isContained = 0;
-    while (std::getline(invFile, s)) {
-        //int pos = s.find(',');
-        //string s1 = s.substr(0, pos);
-        //string s2 = s.substr(pos + 1, string::npos);
-        vector<string> list = str_split(s, "[,-]");
-
-        cout << s << endl;
-        //for (const auto x : list) {
-        //    cout << "    " << x << endl;
-        //}
-
-        int elf1_r1 = stoi(list[0]);
-        int elf1_r2 = stoi(list[1]);
-        int elf2_r1 = stoi(list[2]);
-        int elf2_r2 = stoi(list[3]);
-
-        if ((elf1_r1 >= elf2_r1 && elf1_r2 <= elf2_r2) || (elf2_r1 >= elf1_r1 && elf2_r2 <= elf1_r2)) {
-            ++isContained;
-            cout << "     " << elf1_r1 << " : " << elf1_r2 << " : " << elf2_r1 << " : " << elf2_r2 << endl;
+    if (p < end && *p == c) {
+        ++p;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parses lines of the fixed form "a-b,c-d". Blank lines are skipped, and a
+ * malformed line, including one whose range ends before it starts, is
+ * reported and skipped.
+ */
+Assignments parseAssignments(const string& buf)
+{
+    Assignments asg;
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+
+    size_t estimate = count(buf.begin(), buf.end(), '\n') + 1;
+    asg.elf1Start.reserve(estimate);
+    asg.elf1End.reserve(estimate);
+    asg.elf2Start.reserve(estimate);
+    asg.elf2End.reserve(estimate);
+
+    int lineNum = 0;
+    while (p < end) {
+        ++lineNum;
+        const char* line = p;
+        int64_t a, b, c, d;
+        bool ok = parseNum(p, end, a) && expect(p, end, '-') && parseNum(p, end, b)
+            && expect(p, end, ',')
+            && parseNum(p, end, c) && expect(p, end, '-') && parseNum(p, end, d)
+            && a <= b && c <= d;
+        expect(p, end, '\r');
+        bool eol = p == end || *p == '\n';
+
+        if (ok && eol) {
+            asg.elf1Start.push_back(a);
+            asg.elf1End.push_back(b);
+            asg.elf2Start.push_back(c);
+            asg.elf2End.push_back(d);
+        } else {
+            const char* nl = find(line, end, '\n');
+            string bad(line, nl);
+            if (!bad.empty() && bad.back() == '\r')
+                bad.pop_back();
+            if (!bad.empty())
+                cout << "line " << lineNum << ": bad assignment \"" << bad << "\"" << endl;
+            p = nl;
         }
 
-        cout << s << " : " << elf1_r1 << " : " << elf1_r2 << " : " << elf2_r1 << " : " << elf2_r2 << endl;
+        if (p < end)
+            ++p;
     }
-    cout << "total contained is " << isContained << endl;
+
+    return asg;
 }
 
-void day4_part2()
+/**
+ * Number of pairs where one range fully contains the other. Branch-free so
+ * the loop vectorizes; cost doesn't depend on the range widths.
+ */
+int64_t countContained(const Assignments& asg)
 {
-    std::ifstream invFile;
-    string s;
-
-    invFile.open("elf_ranges.txt");
-    int noOverlapCount = 0;
-    int overlapCount = 0;
-    while (std::getline(invFile, s)) {
-        //int pos = s.find(',');
-        //string s1 = s.substr(0, pos);
-        //string s2 = s.substr(pos + 1, string::npos);
-        vector<string> list = str_split(s, "[,-]");
-
-        cout << s << endl;
-        //for (const auto x : list) {
-        //    cout << "    " << x << endl;
-        //}
-
-        int elf1_r1 = stoi(list[0]);
-        int elf1_r2 = stoi(list[1]);
-        int elf2_r1 = stoi(list[2]);
-        int elf2_r2 = stoi(list[3]);
-
-        int overlap = 0;
-        for (int i = elf1_r1; i <= elf1_r2; ++i) {
-            if (i >= elf2_r1 && i <= elf2_r2) {
-                overlap = 1;
-            }
+    const int64_t* a1 = asg.elf1Start.data();
+    const int64_t* a2 = asg.elf1End.data();
+    const int64_t* b1 = asg.elf2Start.data();
+    const int64_t* b2 = asg.elf2End.data();
+    size_t n = asg.size();
+
+    int64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += ((a1[i] >= b1[i]) & (a2[i] <= b2[i])) | ((b1[i] >= a1[i]) & (b2[i] <= a2[i]));
+    }
+    return count;
+}
+
+/**
+ * Number of pairs whose ranges overlap at all: neither range ends before
+ * the other starts.
+ */
+int64_t countOverlapping(const Assignments& asg)
+{
+    const int64_t* a1 = asg.elf1Start.data();
+    const int64_t* a2 = asg.elf1End.data();
+    const int64_t* b1 = asg.elf2Start.data();
+    const int64_t* b2 = asg.elf2End.data();
+    size_t n = asg.size();
+
+    int64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += (a1[i] <= b2[i]) & (b1[i] <= a2[i]);
+    }
+    return count;
+}
+
+/**
+ * Index over every individual elf assignment (two per pair) for questions
+ * about the whole list rather than one pair at a time.
+ *
+ * Coverage and intersection counts come from the sorted start and end
+ * columns by binary search. Listing the pairs that touch a query range
+ * uses the assignments sorted by start with a max-end tree on top, so only
+ * subtrees that can contain a match are visited. The deepest overlap is
+ * found once at build time by sweeping the sorted endpoints. Every range
+ * is expected to have start <= end, as parseAssignments guarantees.
+ */
+class IntervalIndex {
+private:
+    struct Interval {
+        int64_t start;
+        int64_t end;
+        size_t pair;
+    };
+
+    vector<int64_t> starts;
+    vector<int64_t> ends;
+    vector<Interval> byStart;
+    vector<int64_t> maxEnd;
+    size_t leaves = 1;
+    int64_t depth = 0;
+    int64_t depthAt = 0;
+
+    void collect(size_t node, size_t nodeFirst, size_t nodeLast, size_t limit, int64_t lo,
+        vector<size_t>& pairs) const
+    {
+        if (nodeFirst >= limit || maxEnd[node] < lo)
+            return;
+
+        if (nodeLast - nodeFirst == 1) {
+            pairs.push_back(byStart[nodeFirst].pair);
+            return;
         }
 
-        for (int i = elf2_r1; i <= elf2_r2; ++i) {
-            if (i >= elf1_r1 && i <= elf1_r2) {
-                overlap = 1;
-            }
+        size_t mid = (nodeFirst + nodeLast) / 2;
+        collect(node * 2, nodeFirst, mid, limit, lo, pairs);
+        collect(node * 2 + 1, mid, nodeLast, limit, lo, pairs);
+    }
+
+public:
+    IntervalIndex(const Assignments& asg)
+    {
+        size_t n = asg.size() * 2;
+        starts.reserve(n);
+        ends.reserve(n);
+        byStart.reserve(n);
+        for (size_t i = 0; i < asg.size(); ++i) {
+            byStart.push_back({ asg.elf1Start[i], asg.elf1End[i], i });
+            byStart.push_back({ asg.elf2Start[i], asg.elf2End[i], i });
         }
 
-        
-        if ((elf1_r2 < elf2_r1 || elf1_r1 > elf2_r2) || (elf2_r2 < elf1_r1 || elf2_r1 > elf1_r2)) {
-            ++noOverlapCount;
-            cout << s << " : " << elf1_r1 << " : " << elf1_r2 << " : " << elf2_r1 << " : " << elf2_r2 << endl;
-            if (overlap) {
-                cout << overlap << " BUG, should be overlap" << endl;
-                exit(0);
-            }
-        } else {
-            ++overlapCount;
-            if (! overlap) {
-                cout << overlap << " BUG, should be no overlap" << endl;
-                exit(0);
+        sort(byStart.begin(), byStart.end(), [](const Interval& a, const Interval& b) {
+            return a.start < b.start;
+        });
+        for (const Interval& iv : byStart) {
+            starts.push_back(iv.start);
+            ends.push_back(iv.end);
+        }
+        sort(ends.begin(), ends.end());
+
+        // Max-end tree over byStart, leaves padded out to a power of two.
+        while (leaves < n)
+            leaves *= 2;
+        maxEnd.assign(leaves * 2, INT64_MIN);
+        for (size_t i = 0; i < n; ++i) {
+            maxEnd[leaves + i] = byStart[i].end;
+        }
+        for (size_t node = leaves - 1; node >= 1; --node) {
+            maxEnd[node] = max(maxEnd[node * 2], maxEnd[node * 2 + 1]);
+        }
+
+        // Sweep: a range covers [start, end], so it stops counting at end + 1.
+        // At equal positions ends are processed first, so touching ranges
+        // like 1-3 and 4-6 don't count as stacked.
+        size_t si = 0, ei = 0;
+        int64_t cur = 0;
+        while (si < n) {
+            if (ei < n && ends[ei] + 1 <= starts[si]) {
+                --cur;
+                ++ei;
+            } else {
+                ++cur;
+                if (cur > depth) {
+                    depth = cur;
+                    depthAt = starts[si];
+                }
+                ++si;
             }
         }
+    }
 
+    size_t size() const
+    {
+        return byStart.size();
+    }
+
+    /**
+     * Number of assignments that include the section.
+     */
+    int64_t coverage(int64_t section) const
+    {
+        int64_t started = upper_bound(starts.begin(), starts.end(), section) - starts.begin();
+        int64_t ended = lower_bound(ends.begin(), ends.end(), section) - ends.begin();
+        return started - ended;
+    }
 
+    /**
+     * Greatest number of assignments that include any one section.
+     */
+    int64_t maxDepth() const
+    {
+        return depth;
     }
+
+    /**
+     * Lowest section where maxDepth() is reached.
+     */
+    int64_t maxDepthSection() const
+    {
+        return depthAt;
+    }
+
+    /**
+     * Number of assignments that share at least one section with [lo, hi].
+     * Everything else either starts after hi or ends before lo, and no range
+     * can do both.
+     */
+    int64_t countIntersecting(int64_t lo, int64_t hi) const
+    {
+        int64_t after = starts.end() - upper_bound(starts.begin(), starts.end(), hi);
+        int64_t before = lower_bound(ends.begin(), ends.end(), lo) - ends.begin();
+        return (int64_t)size() - after - before;
+    }
+
+    /**
+     * Indexes of the pairs where either elf's assignment shares a section
+     * with [lo, hi], in ascending order.
+     */
+    vector<size_t> pairsIntersecting(int64_t lo, int64_t hi) const
+    {
+        vector<size_t> pairs;
+        size_t limit = upper_bound(starts.begin(), starts.end(), hi) - starts.begin();
+        if (limit > 0)
+            collect(1, 0, leaves, limit, lo, pairs);
+
+        sort(pairs.begin(), pairs.end());
+        pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+        return pairs;
+    }
+};
+
+/**
+ * Part 1: Determines how many assignment pairs have one range that fully
+ * contains the other.
+ */
+void day4_part1()
+{
+    Assignments asg = parseAssignments(readFile("elf_ranges.txt"));
+    cout << "total contained is " << countContained(asg) << endl;
+}
+
+/**
+ * Part 2: Determines how many assignment pairs overlap at all.
+ */
+void day4_part2()
+{
+    Assignments asg = parseAssignments(readFile("elf_ranges.txt"));
+    int64_t overlapCount = countOverlapping(asg);
     cout << "total overlap is " << overlapCount << endl;
-    cout << "total no overlap is " << noOverlapCount << endl;
+    cout << "total no overlap is " << (int64_t)asg.size() - overlapCount << endl;
+}
+
+/**
+ * Builds the interval index over all assignments and runs a few sample
+ * queries against it.
+ */
+void day4_index()
+{
+    Assignments asg = parseAssignments(readFile("elf_ranges.txt"));
+    IntervalIndex index(asg);
+
+    cout << "assignments: " << index.size() << endl;
+    cout << "max depth is " << index.maxDepth() << " at section " << index.maxDepthSection() << endl;
+
+    for (int64_t section : { (int64_t)1, (int64_t)50, (int64_t)99 }) {
+        cout << "section " << section << " covered by " << index.coverage(section) << endl;
+    }
+
+    vector<size_t> pairs = index.pairsIntersecting(40, 45);
+    cout << index.countIntersecting(40, 45) << " assignments in " << pairs.size()
+        << " pairs intersect 40-45" << endl;
 }
 
 int main()
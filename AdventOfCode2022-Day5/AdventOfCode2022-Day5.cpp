@@ -15,26 +15,32 @@
 #include <set>
 #include <algorithm>
 #include <map>
-#include <regex>
+#include <cctype>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 
 using namespace std;
 
+typedef chrono::high_resolution_clock Clock;
+
+enum CraneModel { CrateMover9000, CrateMover9001 };
+
+/**
+ * One "move N from A to B" step, with the stacks converted to 0-based.
+ */
 struct Move {
-    char myMove;
-    int score;
+    int count;
+    int from;
+    int to;
 };
 
-std::vector<std::string> str_split(const std::string& s, const char* pattern) {
-    std::regex sep_regex = std::regex{ pattern };
-    std::sregex_token_iterator iter(s.begin(), s.end(), sep_regex, -1);
-    std::sregex_token_iterator end;
-    return { iter, end };
-}
-
-void dumpStack(const vector<vector<char>> stacks)
+void dumpStack(const vector<vector<char>>& stacks)
 {
     int i = 1;
-    for (auto s : stacks) {
+    for (const auto& s : stacks) {
         cout << "stack " << i++ << ": ";
         for (auto c : s) {
             cout << " " << c;
@@ -44,60 +50,459 @@ void dumpStack(const vector<vector<char>> stacks)
 }
 
 /**
- * Part 1: Simulates the cargo crane loading procedure using a CrateMover
- * 9000 model. This method reads the initial stacks configuration and the
- * series of moves from a file. It then simulates these moves under the
- * CrateMover 9000's constraints, where crates are moved individually,
- * potentially altering the order within the stacks.
+ * Reads the starting stack drawing up to and including the blank line that
+ * separates it from the moves. The number of stacks and the column each one
+ * occupies come from the numbered footer line, so any stack count works.
+ * Each stack is built top-down by appending, then reversed once so the
+ * bottom crate is first and the top crate is back().
  */
-void day5_part1()
+vector<vector<char>> loadStacks(istream& in)
 {
-    std::ifstream invFile;
     string s;
+    vector<string> drawing;
+    while (std::getline(in, s)) {
+        if (!s.empty() && s.back() == '\r')
+            s.pop_back();
+        if (s.empty())
+            break;
+        drawing.push_back(s);
+    }
+
     vector<vector<char>> stacks;
-    for (int i = 0; i < 9; ++i) {
-        stacks.push_back(vector<char>{});
+    if (drawing.empty())
+        return stacks;
+
+    // Each run of digits in the footer names one stack. The crate letter sits
+    // somewhere under that run (exactly under it for single-digit numbers).
+    const string& footer = drawing.back();
+    vector<pair<size_t, size_t>> columns;
+    for (size_t i = 0; i < footer.length(); ) {
+        if (!isdigit((unsigned char)footer[i])) {
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        while (i < footer.length() && isdigit((unsigned char)footer[i]))
+            ++i;
+        columns.push_back({ start, i });
     }
- 
-    invFile.open("crates.txt");
-    while (std::getline(invFile, s)) {
-        cout << s << endl;
-        if (s == "")
-            break;
 
-        if (s.substr(1, 1) == "1")
+    stacks.resize(columns.size());
+    size_t numRows = drawing.size() - 1;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        stacks[i].reserve(numRows);
+    }
+
+    for (size_t row = 0; row < numRows; ++row) {
+        const string& line = drawing[row];
+        for (size_t i = 0; i < columns.size(); ++i) {
+            for (size_t pos = columns[i].first; pos < columns[i].second && pos < line.length(); ++pos) {
+                if (isalpha((unsigned char)line[pos])) {
+                    stacks[i].push_back(line[pos]);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto& stack : stacks) {
+        reverse(stack.begin(), stack.end());
+    }
+
+    return stacks;
+}
+
+string stackTops(const vector<vector<char>>& stacks)
+{
+    string tops;
+    for (const auto& stack : stacks) {
+        tops += stack.empty() ? ' ' : stack.back();
+    }
+    return tops;
+}
+
+/**
+ * Parses the remaining "move N from A to B" lines. Only the three numbers
+ * are looked at, in order; lines without three numbers are skipped.
+ */
+vector<Move> loadMoves(istream& in)
+{
+    string s;
+    vector<Move> moves;
+    while (std::getline(in, s)) {
+        int nums[3];
+        int found = 0;
+        const char* p = s.c_str();
+        while (*p && found < 3) {
+            if (*p < '0' || *p > '9') {
+                ++p;
+                continue;
+            }
+            int v = 0;
+            while (*p >= '0' && *p <= '9') {
+                v = v * 10 + (*p - '0');
+                ++p;
+            }
+            nums[found++] = v;
+        }
+        if (found == 3) {
+            moves.push_back({ nums[0], nums[1] - 1, nums[2] - 1 });
+        }
+    }
+    return moves;
+}
+
+/**
+ * Stack heights through the move list, without moving any crates. If
+ * requested, also the heights of each move's from and to stacks just
+ * before the move, which is what the backward resolver needs.
+ */
+struct HeightTrace {
+    vector<size_t> final;
+    vector<size_t> tallest;
+    vector<size_t> fromBefore;
+    vector<size_t> toBefore;
+};
+
+/**
+ * Runs through the moves tracking only stack heights. Bad moves (unknown
+ * stack, or more crates than the stack has) are reported and stop the
+ * program.
+ */
+HeightTrace traceHeights(const vector<vector<char>>& stacks, const vector<Move>& moves, bool recordMoves)
+{
+    HeightTrace trace;
+    vector<size_t>& height = trace.final;
+    height.resize(stacks.size());
+    trace.tallest.resize(stacks.size());
+    for (size_t i = 0; i < stacks.size(); ++i) {
+        height[i] = trace.tallest[i] = stacks[i].size();
+    }
+    if (recordMoves) {
+        trace.fromBefore.reserve(moves.size());
+        trace.toBefore.reserve(moves.size());
+    }
+
+    for (size_t m = 0; m < moves.size(); ++m) {
+        const Move& mv = moves[m];
+        if (mv.from < 0 || mv.from >= (int)stacks.size() || mv.to < 0 || mv.to >= (int)stacks.size()
+            || mv.count < 0 || (size_t)mv.count > height[mv.from]) {
+            cout << "BAD MOVE " << m + 1 << ": " << mv.count << " from " << mv.from + 1 << " to " << mv.to + 1 << endl;
+            exit(0);
+        }
+        if (recordMoves) {
+            trace.fromBefore.push_back(height[mv.from]);
+            trace.toBefore.push_back(height[mv.to]);
+        }
+        height[mv.from] -= mv.count;
+        height[mv.to] += mv.count;
+        trace.tallest[mv.to] = max(trace.tallest[mv.to], height[mv.to]);
+    }
+
+    return trace;
+}
+
+/**
+ * Reserves each stack for the tallest it will get during the moves, so
+ * applying them never reallocates.
+ */
+void reserveStacks(vector<vector<char>>& stacks, const vector<Move>& moves)
+{
+    HeightTrace trace = traceHeights(stacks, moves, false);
+    for (size_t i = 0; i < stacks.size(); ++i) {
+        stacks[i].reserve(trace.tallest[i]);
+    }
+}
+
+/**
+ * Moves the top count crates of one stack onto another as a single block.
+ * The CrateMover 9001 keeps their order, so it's a straight copy; the
+ * CrateMover 9000 moves them one at a time, which lands them reversed.
+ */
+void moveCrates(vector<vector<char>>& stacks, const Move& mv, CraneModel model)
+{
+    // Either crane just puts the crates back where they were, and moving
+    // nothing leaves both stacks alone.
+    if (mv.from == mv.to || mv.count == 0)
+        return;
+
+    vector<char>& from = stacks[mv.from];
+    size_t count = mv.count;
+    size_t remain = from.size() - count;
+    vector<char>& to = stacks[mv.to];
+    size_t base = to.size();
+    to.resize(base + count);
+    if (model == CrateMover9001) {
+        memcpy(to.data() + base, from.data() + remain, count);
+    } else {
+        reverse_copy(from.begin() + remain, from.end(), to.begin() + base);
+    }
+    from.resize(remain);
+}
+
+void applyMoves(vector<vector<char>>& stacks, const vector<Move>& moves, CraneModel model)
+{
+    reserveStacks(stacks, moves);
+    for (const Move& mv : moves) {
+        moveCrates(stacks, mv, model);
+    }
+}
+
+/**
+ * Finds the final top crate of every stack without moving any crates. For
+ * each stack, start at its final top position and walk the moves backwards:
+ * if the position is inside the block a move dropped on this stack, map it
+ * back to where that crate sat on the source stack (same order for the
+ * 9001, reversed for the 9000). Whatever position is left at the start is
+ * in the original drawing. Cost is O(moves x stacks) however many crates
+ * each move carries.
+ */
+string resolveTops(const vector<vector<char>>& stacks, const vector<Move>& moves, CraneModel model)
+{
+    HeightTrace trace = traceHeights(stacks, moves, true);
+
+    string tops;
+    for (size_t s = 0; s < stacks.size(); ++s) {
+        if (trace.final[s] == 0) {
+            tops += ' ';
             continue;
+        }
 
-        for (int i = 0; i < 9; ++i) {
-            char letter = s.substr(i * 4 + 1, 1)[0];
-            if (letter != ' ') {
-                cout << " : " << letter;
-                stacks[i].insert(stacks[i].begin(), letter);
+        int stack = (int)s;
+        size_t pos = trace.final[s] - 1;
+        for (size_t m = moves.size(); m-- > 0; ) {
+            const Move& mv = moves[m];
+            if (mv.to != stack || mv.from == mv.to || pos < trace.toBefore[m])
+                continue;
+
+            size_t k = pos - trace.toBefore[m];
+            if (model == CrateMover9001)
+                pos = trace.fromBefore[m] - mv.count + k;
+            else
+                pos = trace.fromBefore[m] - 1 - k;
+            stack = mv.from;
+        }
+        tops += stacks[stack][pos];
+    }
+    return tops;
+}
+
+/**
+ * Stack contents at any point in the move list, without re-simulating from
+ * the start. Every interval moves a full copy of the stacks is kept as a
+ * checkpoint, along with the per-move heights from traceHeights.
+ *
+ * A query after move k starts from the last checkpoint at or before k and
+ * walks the moves in between backwards, the same way resolveTops does, so
+ * it costs O(interval) for a top and O(interval^2 + height) at worst for a
+ * full stack. The default interval is sqrt(moves). Checkpoint memory is
+ * about total crates x (moves / interval), so pass a larger interval for
+ * yards too big to copy that often.
+ */
+class StackHistory {
+private:
+    // A run of len output crates: positions lo..lo+len-1 on a stack, read
+    // top-down instead when reversed.
+    struct Segment {
+        int stack;
+        size_t lo;
+        size_t len;
+        bool reversed;
+    };
+
+    vector<Move> moves;
+    CraneModel model;
+    size_t interval;
+    HeightTrace trace;
+    vector<vector<vector<char>>> checkpoints;
+
+    size_t checkpointFor(size_t afterMove) const
+    {
+        return min(afterMove / interval, checkpoints.size() - 1);
+    }
+
+    /**
+     * Maps a range of stack positions after move k back to ranges in the
+     * checkpoint at or before k.
+     */
+    vector<Segment> resolve(Segment seg, size_t afterMove) const
+    {
+        vector<Segment> segs{ seg };
+        size_t first = checkpointFor(afterMove) * interval;
+        for (size_t m = afterMove; m-- > first; ) {
+            const Move& mv = moves[m];
+            if (mv.from == mv.to || mv.count == 0)
+                continue;
+
+            size_t boundary = trace.toBefore[m];
+            vector<Segment> next;
+            next.reserve(segs.size() + 1);
+            for (const Segment& sg : segs) {
+                if (sg.stack != mv.to || sg.lo + sg.len <= boundary) {
+                    next.push_back(sg);
+                    continue;
+                }
+
+                // Split into the part that was already there and the part
+                // that arrived with this move.
+                size_t cut = max(sg.lo, boundary);
+                Segment low = { sg.stack, sg.lo, cut - sg.lo, sg.reversed };
+                Segment high;
+                size_t highLen = sg.lo + sg.len - cut;
+                size_t offset = cut - boundary;
+                high.stack = mv.from;
+                high.len = highLen;
+                if (model == CrateMover9001) {
+                    high.lo = trace.fromBefore[m] - mv.count + offset;
+                    high.reversed = sg.reversed;
+                } else {
+                    high.lo = trace.fromBefore[m] - offset - highLen;
+                    high.reversed = !sg.reversed;
+                }
+
+                if (!sg.reversed) {
+                    if (low.len > 0)
+                        next.push_back(low);
+                    next.push_back(high);
+                } else {
+                    next.push_back(high);
+                    if (low.len > 0)
+                        next.push_back(low);
+                }
             }
+            segs.swap(next);
         }
-        cout << endl;
+        return segs;
     }
 
-    dumpStack(stacks);
+public:
+    StackHistory(const vector<vector<char>>& stacks, const vector<Move>& moveList, CraneModel crane,
+        size_t checkpointInterval = 0)
+        : moves(moveList), model(crane)
+    {
+        trace = traceHeights(stacks, moves, true);
+
+        interval = checkpointInterval;
+        if (interval == 0)
+            interval = max((size_t)sqrt((double)moves.size()), (size_t)1);
+
+        vector<vector<char>> cur = stacks;
+        reserveStacks(cur, moves);
+        checkpoints.push_back(cur);
+        for (size_t m = 0; m < moves.size(); ++m) {
+            moveCrates(cur, moves[m], model);
+            if ((m + 1) % interval == 0)
+                checkpoints.push_back(cur);
+        }
+    }
 
-    while (std::getline(invFile, s)) {
-        vector<string> list = str_split(s, " ");
-        int count = stoi(list[1]);
-        int from = stoi(list[3]);
-        int to = stoi(list[5]);
+    size_t numMoves() const
+    {
+        return moves.size();
+    }
 
-        cout << "MOVE: " << count << " FROM " << from << " TO " << to << endl;
-        --from;
-        --to;
+    size_t numStacks() const
+    {
+        return checkpoints[0].size();
+    }
 
-        for (int i = 0; i < count; ++i) {
-            char crate = stacks[from].back();
-            stacks[from].pop_back();
-            stacks[to].push_back(crate);
+    /**
+     * Height of the stack after the first afterMove moves (0 is the starting
+     * drawing). afterMove past the end means after the last move.
+     */
+    size_t height(int stack, size_t afterMove) const
+    {
+        afterMove = min(afterMove, moves.size());
+        size_t cp = checkpointFor(afterMove);
+        size_t h = checkpoints[cp][stack].size();
+        for (size_t m = cp * interval; m < afterMove; ++m) {
+            if (moves[m].from == stack)
+                h -= moves[m].count;
+            if (moves[m].to == stack)
+                h += moves[m].count;
         }
+        return h;
+    }
+
+    /**
+     * Top crate of the stack after the first afterMove moves, or ' ' if the
+     * stack is empty.
+     */
+    char top(int stack, size_t afterMove) const
+    {
+        afterMove = min(afterMove, moves.size());
+        size_t h = height(stack, afterMove);
+        if (h == 0)
+            return ' ';
+
+        Segment seg = resolve({ stack, h - 1, 1, false }, afterMove)[0];
+        return checkpoints[checkpointFor(afterMove)][seg.stack][seg.lo];
     }
 
+    /**
+     * Whole stack, bottom crate first, after the first afterMove moves.
+     */
+    vector<char> stackAt(int stack, size_t afterMove) const
+    {
+        afterMove = min(afterMove, moves.size());
+        size_t h = height(stack, afterMove);
+        vector<char> result;
+        result.reserve(h);
+        if (h == 0)
+            return result;
+
+        const vector<vector<char>>& base = checkpoints[checkpointFor(afterMove)];
+        for (const Segment& seg : resolve({ stack, 0, h, false }, afterMove)) {
+            const char* p = base[seg.stack].data() + seg.lo;
+            if (seg.reversed)
+                result.insert(result.end(), reverse_iterator<const char*>(p + seg.len), reverse_iterator<const char*>(p));
+            else
+                result.insert(result.end(), p, p + seg.len);
+        }
+        return result;
+    }
+
+    string topsAt(size_t afterMove) const
+    {
+        string tops;
+        for (size_t s = 0; s < numStacks(); ++s) {
+            tops += top((int)s, afterMove);
+        }
+        return tops;
+    }
+};
+
+/**
+ * Loads crates.txt and runs all the moves with the given crane.
+ */
+void day5_run(CraneModel model)
+{
+    std::ifstream invFile;
+
+    invFile.open("crates.txt");
+    vector<vector<char>> stacks = loadStacks(invFile);
+    vector<Move> moves = loadMoves(invFile);
+    dumpStack(stacks);
+
+    string offline = resolveTops(stacks, moves, model);
+
+    applyMoves(stacks, moves, model);
+
     dumpStack(stacks);
+    cout << "tops: " << stackTops(stacks) << endl;
+    cout << "offline tops: " << offline << endl;
+}
+
+/**
+ * Part 1: Simulates the cargo crane loading procedure using a CrateMover
+ * 9000 model. This method reads the initial stacks configuration and the
+ * series of moves from a file. It then simulates these moves under the
+ * CrateMover 9000's constraints, where crates are moved individually,
+ * potentially altering the order within the stacks.
+ */
+void day5_part1()
+{
+    day5_run(CrateMover9000);
 }
 
 /**
@@ -108,59 +513,89 @@ void day5_part1()
  */
 void day5_part2()
 {
-    std::ifstream invFile;
-    string s;
-    vector<vector<char>> stacks;
-    for (int i = 0; i < 9; ++i) {
-        stacks.push_back(vector<char>{});
-    }
+    day5_run(CrateMover9001);
+}
 
-    invFile.open("crates.txt");
-    while (std::getline(invFile, s)) {
-        cout << s << endl;
-        if (s == "")
-            break;
+/**
+ * Times full simulation against backward resolution of the tops, on a
+ * random yard of numStacks stacks holding numCrates crates in total and
+ * numMoves moves of up to half the source stack each.
+ */
+void day5_benchmark(int numStacks, int numCrates, int numMoves)
+{
+    mt19937 rng(2022);
+    vector<vector<char>> stacks(numStacks);
+    for (int i = 0; i < numCrates; ++i) {
+        stacks[rng() % numStacks].push_back('A' + rng() % 26);
+    }
 
-        if (s.substr(1, 1) == "1")
+    vector<size_t> height(numStacks);
+    for (int i = 0; i < numStacks; ++i) {
+        height[i] = stacks[i].size();
+    }
+    vector<Move> moves;
+    moves.reserve(numMoves);
+    while ((int)moves.size() < numMoves) {
+        int from = rng() % numStacks;
+        int to = rng() % numStacks;
+        if (height[from] == 0)
             continue;
+        int count = 1 + rng() % (height[from] / 2 + 1);
+        height[from] -= count;
+        height[to] += count;
+        moves.push_back({ count, from, to });
+    }
 
-        for (int i = 0; i < 9; ++i) {
-            char letter = s.substr(i * 4 + 1, 1)[0];
-            if (letter != ' ') {
-                cout << " : " << letter;
-                stacks[i].insert(stacks[i].begin(), letter);
-            }
-        }
-        cout << endl;
+    for (CraneModel model : { CrateMover9000, CrateMover9001 }) {
+        const char* name = model == CrateMover9000 ? "9000" : "9001";
+
+        auto t1 = Clock::now();
+        vector<vector<char>> sim = stacks;
+        applyMoves(sim, moves, model);
+        string simTops = stackTops(sim);
+        auto t2 = Clock::now();
+        string offTops = resolveTops(stacks, moves, model);
+        auto t3 = Clock::now();
+
+        cout << "CrateMover " << name << ": simulate "
+            << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " ms, offline "
+            << chrono::duration_cast<chrono::milliseconds>(t3 - t2).count() << " ms, "
+            << (simTops == offTops ? "tops match" : "TOPS DIFFER") << endl;
     }
+}
 
-    dumpStack(stacks);
+/**
+ * Builds the move history for crates.txt and checks checkpoint queries
+ * against a plain simulation at every move.
+ */
+void day5_history(CraneModel model)
+{
+    std::ifstream invFile;
 
-    while (std::getline(invFile, s)) {
-        vector<string> list = str_split(s, " ");
-        int count = stoi(list[1]);
-        int from = stoi(list[3]);
-        int to = stoi(list[5]);
-
-        cout << "MOVE: " << count << " FROM " << from << " TO " << to << endl;
-        --from;
-        --to;
-
-        vector<char> move;
-        for (int i = 0; i < count; ++i) {
-            char crate = stacks[from].back();
-            cout << "   pop: " << crate << endl;
-            stacks[from].pop_back();
-            move.push_back(crate);
-        }
-        for (int i = count-1; i >= 0; --i) {
-            char crate = move[i];
-            cout << "   push: " << crate << endl;
-            stacks[to].push_back(crate);
+    invFile.open("crates.txt");
+    vector<vector<char>> stacks = loadStacks(invFile);
+    vector<Move> moves = loadMoves(invFile);
+
+    StackHistory history(stacks, moves, model);
+
+    vector<vector<char>> sim = stacks;
+    reserveStacks(sim, moves);
+    int mismatches = 0;
+    for (size_t k = 0; k <= moves.size(); ++k) {
+        if (k > 0)
+            moveCrates(sim, moves[k - 1], model);
+        if (history.topsAt(k) != stackTops(sim))
+            ++mismatches;
+        for (size_t s = 0; s < sim.size(); ++s) {
+            if (history.stackAt((int)s, k) != sim[s])
+                ++mismatches;
         }
     }
 
-    dumpStack(stacks);
+    size_t half = moves.size() / 2;
+    cout << "tops after move " << half << ": " << history.topsAt(half) << endl;
+    cout << "tops after move " << moves.size() << ": " << history.topsAt(moves.size()) << endl;
+    cout << "mismatches against simulation: " << mismatches << endl;
 }
 
 int main()
@@ -13,127 +13,329 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <set>
 #include <algorithm>
-#include <map>
-#include <regex>
-#include <queue>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-struct Move {
-    char myMove;
-    int score;
-};
+typedef chrono::high_resolution_clock Clock;
 
-bool checkDup(string q)
+/**
+ * Reads the whole stream into memory, minus any trailing line ending.
+ */
+string readStream(const string& filename)
 {
-    map <char, bool> chk;
-    cout << "Checking: " << q << endl;
-    for (auto c : q) {
-        if (chk.find(c) != chk.end()) {
-            cout << "true" << endl;
-            return true;
+    ifstream in(filename, ios::binary);
+    string buf;
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    if (size <= 0)
+        return buf;
+    buf.resize((size_t)size);
+    in.seekg(0, ios::beg);
+    in.read(&buf[0], size);
+
+    while (!buf.empty() && (buf.back() == '\n' || buf.back() == '\r'))
+        buf.pop_back();
+    return buf;
+}
+
+/**
+ * Finds the first marker: a run of window characters that are all
+ * different. Keeps a count of each character in the current window and how
+ * many characters appear more than once, so each byte is O(1) with no
+ * allocation whatever the window size.
+ *
+ * Returns the number of characters processed through the end of the
+ * marker, or 0 if there is none.
+ */
+size_t findMarker(const string& stream, int window)
+{
+    if (window < 1)
+        return 0;
+
+    int counts[256] = { 0 };
+    int dups = 0;
+    const unsigned char* data = (const unsigned char*)stream.data();
+    size_t len = stream.length();
+
+    for (size_t i = 0; i < len; ++i) {
+        if (counts[data[i]]++ == 1)
+            ++dups;
+
+        if (i >= (size_t)window) {
+            if (--counts[data[i - window]] == 1)
+                --dups;
         }
-        chk[c] = true;
+
+        if (i + 1 >= (size_t)window && dups == 0)
+            return i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Finds the first marker of every window size in one pass. Tracks where
+ * each character was last seen and where the current run of distinct
+ * characters starts; the run grows by at most one per byte, so the first
+ * time it reaches length w is the first marker of size w.
+ *
+ * Entry w of the result is the character count through the end of the
+ * first size-w marker; entry 0 is unused. The result stops at the longest
+ * distinct run in the stream, which is at most 26 for a lowercase stream.
+ */
+vector<size_t> findAllMarkers(const string& stream)
+{
+    vector<size_t> firstEnd(1, 0);
+    size_t lastSeen[256];
+    fill(begin(lastSeen), end(lastSeen), 0);
+    size_t runStart = 0;
+    const unsigned char* data = (const unsigned char*)stream.data();
+    size_t len = stream.length();
+
+    // lastSeen holds position + 1 so 0 can mean "not yet seen".
+    for (size_t i = 0; i < len; ++i) {
+        size_t prev = lastSeen[data[i]];
+        if (prev > runStart)
+            runStart = prev;
+        lastSeen[data[i]] = i + 1;
+
+        size_t runLen = i + 1 - runStart;
+        if (runLen == firstEnd.size())
+            firstEnd.push_back(i + 1);
     }
-    cout << "false" << endl;
-    return false;
+
+    return firstEnd;
 }
 
-bool checkDupx(string q)
+/**
+ * Scans marker end positions [first, last) with the count-array method,
+ * priming the counts from the window - 1 bytes before first. Adds the
+ * character count through each marker end to found, or just the first one
+ * unless all is set. Requires first >= window - 1.
+ */
+void scanMarkersScalar(const unsigned char* data, size_t first, size_t last, int window, bool all,
+    vector<size_t>& found)
 {
-    string chk = "";
-    cout << "Checking: " << q << endl;
-    for (auto c : q) {
-        cout << "   check (" << chk << "): " << c << endl;
-        if (chk.find(c) != string::npos) {
-            cout << "true" << endl;
-            return true;
+    int counts[256] = { 0 };
+    int dups = 0;
+    for (size_t i = first + 1 - window; i < first; ++i) {
+        if (counts[data[i]]++ == 1)
+            ++dups;
+    }
+
+    for (size_t i = first; i < last; ++i) {
+        if (counts[data[i]]++ == 1)
+            ++dups;
+        if (dups == 0) {
+            found.push_back(i + 1);
+            if (!all)
+                return;
         }
-        chk += c;
+        if (--counts[data[i + 1 - window]] == 1)
+            --dups;
     }
-    cout << "false" << endl;
-    return false;
 }
 
+#ifdef __AVX2__
 /**
- * Part 1: Process the data stream to find the first start-of-packet marker,
- * identified as a sequence of 4 characters where all characters are distinct.
- * This method reads from a file character by character, maintaining a rolling
- * sequence of 4 characters, checks for uniqueness within this sequence.
- * The count of characters processed is returned when a valid start-of-packet
- * marker is found.
+ * True if every byte in [first, last) is a lowercase letter.
  */
-void day6_part1()
+bool allLowercase(const unsigned char* data, size_t first, size_t last)
 {
-    string s;
-    string q;
-    int count = 0;
-
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
-    ifstream in;
-    in.open("stream.txt");
-    while (! in.eof()) {
-        char c = in.get();
-        cout << c << " ";
-        ++count;
-
-        q = q + c;
-        if (q.length() > 4) {
-            q = q.substr(1);
+    for (size_t i = first; i < last; ++i) {
+        if (data[i] < 'a' || data[i] > 'z')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Same as scanMarkersScalar, eight marker ends at a time. Each byte becomes
+ * a 32-bit lane with bit (c - 'a') set, and the window is ORed together
+ * from window shifted 8-byte loads. The window is all different exactly
+ * when the OR has window bits set, counted with a nibble popcount table.
+ * That only tells the 26 letters apart, so a range holding any other byte
+ * goes to the scalar scan, as do windows over 26, which can't be all
+ * different letters. Either way the result matches findMarker.
+ */
+void scanMarkers(const unsigned char* data, size_t first, size_t last, int window, bool all,
+    vector<size_t>& found)
+{
+    if (window > 26 || !allLowercase(data, first + 1 - window, last)) {
+        scanMarkersScalar(data, first, last, window, all, found);
+        return;
+    }
+
+    const __m256i letterA = _mm256_set1_epi32('a');
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i want = _mm256_set1_epi32(window);
+    const __m256i loNibble = _mm256_set1_epi8(0x0f);
+    const __m256i popLut = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        __m256i seen = _mm256_setzero_si256();
+        for (int j = 0; j < window; ++j) {
+            __m128i bytes = _mm_loadl_epi64((const __m128i*)(data + i - j));
+            __m256i shift = _mm256_sub_epi32(_mm256_cvtepu8_epi32(bytes), letterA);
+            seen = _mm256_or_si256(seen, _mm256_sllv_epi32(one, shift));
         }
 
-        cout << "queue: " << q << endl;
+        __m256i cnt = _mm256_add_epi8(
+            _mm256_shuffle_epi8(popLut, _mm256_and_si256(seen, loNibble)),
+            _mm256_shuffle_epi8(popLut, _mm256_and_si256(_mm256_srli_epi16(seen, 4), loNibble)));
+        cnt = _mm256_madd_epi16(_mm256_maddubs_epi16(cnt, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+        int hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(cnt, want)));
 
-        if (q.length() > 3 && q[0] != q[1] && q[0] != q[2] && q[0] != q[3]
-            && q[1] != q[2] && q[1] != q[3]
-            && q[2] != q[3])
-        {
-            break;
+        for (int b = 0; hits != 0; ++b, hits >>= 1) {
+            if (hits & 1) {
+                found.push_back(i + b + 1);
+                if (!all)
+                    return;
+            }
         }
     }
 
-    cout << "count is " << count << endl;
+    if (i < last)
+        scanMarkersScalar(data, i, last, window, all, found);
 }
+#else
+void scanMarkers(const unsigned char* data, size_t first, size_t last, int window, bool all,
+    vector<size_t>& found)
+{
+    scanMarkersScalar(data, first, last, window, all, found);
+}
+#endif
 
 /**
- * Part 2: Process the data stream to find the first start-of-message marker,
- * which is identified as a sequence of 14 distinct characters.
- * This method reads from a file character by character, maintaining a
- * rolling sequence of 14 characters, and checks for uniqueness using the
- * checkDup method. The count of characters processed is returned when
- * a valid start-of-message marker is found.
+ * Marker search for very large streams. The marker end positions are
+ * split into one contiguous chunk per thread; each chunk also reads the
+ * window - 1 bytes before it, so markers straddling a split are found.
+ *
+ * With all set, returns the character count through every marker end in
+ * order. Otherwise returns just the first one (or nothing). Each thread
+ * works in blocks and gives up once an earlier chunk has found a marker,
+ * since nothing it finds could be first.
  */
-void day6_part2()
+vector<size_t> searchMarkers(const string& stream, int window, bool all,
+    int numThreads = max((int)thread::hardware_concurrency(), 1))
 {
-    string s;
-    string q;
-    int count = 0;
-
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
-    ifstream in;
-    in.open("stream.txt");
-    while (! in.eof()) {
-        char c = in.get();
-        cout << c << " ";
-        ++count;
-
-        q = q + c;
-        if (q.length() > 14) {
-            q = q.substr(1);
+    vector<size_t> result;
+    if (window < 1 || stream.length() < (size_t)window)
+        return result;
+
+    const unsigned char* data = (const unsigned char*)stream.data();
+    const size_t blockSize = 1 << 16;
+    size_t begin = window - 1;
+    size_t total = stream.length() - begin;
+    size_t threads = min((size_t)max(numThreads, 1), max(total / blockSize, (size_t)1));
+    size_t per = (total + threads - 1) / threads;
+
+    vector<vector<size_t>> found(threads);
+    atomic<size_t> firstChunk(threads);
+
+    auto work = [&](size_t chunk) {
+        size_t first = begin + chunk * per;
+        size_t last = min(first + per, stream.length());
+        for (size_t block = first; block < last; block += blockSize) {
+            if (!all && firstChunk.load() < chunk)
+                return;
+
+            scanMarkers(data, block, min(block + blockSize, last), window, all, found[chunk]);
+            if (!all && !found[chunk].empty()) {
+                size_t cur = firstChunk.load();
+                while (chunk < cur && !firstChunk.compare_exchange_weak(cur, chunk))
+                    ;
+                return;
+            }
         }
+    };
 
-        cout << "queue: " << q << endl;
+    if (threads == 1) {
+        work(0);
+    } else {
+        vector<thread> pool;
+        for (size_t chunk = 0; chunk < threads; ++chunk) {
+            pool.emplace_back(work, chunk);
+        }
+        for (thread& t : pool) {
+            t.join();
+        }
+    }
 
-        if (q.length() >= 14 && !checkDup(q)) {
+    for (const vector<size_t>& f : found) {
+        result.insert(result.end(), f.begin(), f.end());
+        if (!all && !result.empty()) {
+            result.resize(1);
             break;
         }
     }
+    return result;
+}
 
-    cout << "count is " << count << endl;
+/**
+ * Part 1: Process the data stream to find the first start-of-packet marker,
+ * identified as a sequence of 4 characters where all characters are distinct.
+ * The count of characters processed is printed when a valid start-of-packet
+ * marker is found.
+ */
+void day6_part1()
+{
+    string stream = readStream("stream.txt");
+    cout << "count is " << findMarker(stream, 4) << endl;
 }
 
+/**
+ * Part 2: Process the data stream to find the first start-of-message marker,
+ * which is identified as a sequence of 14 distinct characters.
+ */
+void day6_part2()
+{
+    string stream = readStream("stream.txt");
+    cout << "count is " << findMarker(stream, 14) << endl;
+}
+
+/**
+ * Reports the first marker for every window size from a single scan, which
+ * covers both parts at once.
+ */
+void day6_all()
+{
+    string stream = readStream("stream.txt");
+    vector<size_t> firstEnd = findAllMarkers(stream);
+    for (size_t w = 1; w < firstEnd.size(); ++w) {
+        cout << "window " << w << ": count is " << firstEnd[w] << endl;
+    }
+}
+
+/**
+ * Runs the threaded search over stream.txt: the first marker for both
+ * parts and a count of every start-of-message marker position.
+ */
+void day6_parallel()
+{
+    string stream = readStream("stream.txt");
+
+    auto t1 = Clock::now();
+    vector<size_t> packet = searchMarkers(stream, 4, false);
+    vector<size_t> message = searchMarkers(stream, 14, false);
+    vector<size_t> allMessages = searchMarkers(stream, 14, true);
+    auto t2 = Clock::now();
+
+    cout << "packet count is " << (packet.empty() ? 0 : packet[0]) << endl;
+    cout << "message count is " << (message.empty() ? 0 : message[0]) << endl;
+    cout << allMessages.size() << " message marker positions" << endl;
+    cout << "Duration: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds" << endl;
+}
 
 int main()
 {
@@ -15,209 +15,892 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <set>
+#include <deque>
 #include <algorithm>
-#include <map>
-#include <regex>
-#include <queue>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 enum entry_type { DirType, FileType };
 
-class Entry {
-public:
+/**
+ * Hash key for looking up a child by name within a directory, where DirId
+ * is however the directory is identified.
+ */
+template <typename DirId>
+struct ChildKey {
+    DirId dir;
+    string name;
 
-    struct File {
-	    int size;
-    };
+    bool operator==(const ChildKey& other) const
+    {
+        return dir == other.dir && name == other.name;
+    }
+};
 
-    struct Dir {
-	Entry* parent;
-	vector<Entry*> *entries;
-	int totalSize;
-    };
+template <typename DirId>
+struct ChildKeyHash {
+    size_t operator()(const ChildKey<DirId>& key) const
+    {
+        return hash<string>()(key.name) ^ (hash<DirId>()(key.dir) * 31);
+    }
+};
 
+class Entry {
+public:
     string name;
-    union {
-        struct File f;
-        struct Dir d;
-    } data;
     entry_type type;
+    Entry* parent;
+    Entry* firstChild;
+    Entry* nextSibling;
+
+    // File size, or for a directory the total of everything under it once
+    // FS::computeSizes() has run.
+    long long size;
+
+    // Position in creation order.
+    size_t id;
+};
+
+/**
+ * Directory totals sorted once, with prefix sums, so size threshold queries
+ * are a binary search each instead of a walk over the tree.
+ */
+class SizeIndex {
+private:
+    vector<long long> sizes;
+    vector<long long> prefix;   // prefix[i] is the sum of sizes[0..i)
+
+public:
+    SizeIndex(vector<long long> dirSizes)
+        : sizes(move(dirSizes))
+    {
+        sort(sizes.begin(), sizes.end());
+        prefix.resize(sizes.size() + 1);
+        prefix[0] = 0;
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            prefix[i + 1] = prefix[i] + sizes[i];
+        }
+    }
+
+    size_t numDirs() const
+    {
+        return sizes.size();
+    }
+
+    /**
+     * Number of directories with a total of at most limit.
+     */
+    size_t countAtMost(long long limit) const
+    {
+        return upper_bound(sizes.begin(), sizes.end(), limit) - sizes.begin();
+    }
+
+    /**
+     * Sum of every directory total that is at most limit.
+     */
+    long long sumAtMost(long long limit) const
+    {
+        return prefix[countAtMost(limit)];
+    }
+
+    /**
+     * Smallest directory total of at least need, or -1 if none is that big.
+     */
+    long long smallestAtLeast(long long need) const
+    {
+        auto it = lower_bound(sizes.begin(), sizes.end(), need);
+        return it == sizes.end() ? -1 : *it;
+    }
+
+    const vector<long long>& sortedSizes() const
+    {
+        return sizes;
+    }
+
+    const vector<long long>& prefixSums() const
+    {
+        return prefix;
+    }
+};
+
+/**
+ * On-disk layout of a filesystem snapshot. Everything is fixed-size and
+ * refers to other parts by index or byte offset, never by pointer, so the
+ * file can be mapped and read in place:
+ *
+ *   header | nodes[numNodes] | sortedSizes[numDirs] | prefixSums[numDirs + 1] | names
+ *
+ * Nodes are in creation order, so every parent comes before its children.
+ * The sorted directory totals and their prefix sums are the SizeIndex, so
+ * threshold queries need no setup after mapping. The header also records
+ * the size and modification time of the log the image was built from, so a
+ * changed log makes the image stale.
+ */
+const char SNAPSHOT_MAGIC[8] = { 'A', 'O', 'C', '7', 'F', 'S', 'I', 'M' };
+const uint32_t SNAPSHOT_VERSION = 2;
+const uint32_t NO_PARENT = 0xffffffff;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numNodes;
+    uint64_t numDirs;
+    uint64_t nodesOffset;
+    uint64_t sizesOffset;
+    uint64_t prefixOffset;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+/**
+ * Size and last-write time of a file, in whatever units the platform
+ * reports; they're only ever compared for equality.
+ */
+struct SourceStamp {
+    uint64_t size;
+    int64_t time;
+};
+
+bool statSource(const string& filename, SourceStamp& stamp)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attr))
+        return false;
+    stamp.size = (uint64_t)attr.nFileSizeHigh << 32 | attr.nFileSizeLow;
+    stamp.time = (int64_t)((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32 | attr.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    stamp.size = (uint64_t)st.st_size;
+    stamp.time = (int64_t)st.st_mtime;
+#endif
+    return true;
+}
+
+struct SnapshotNode {
+    uint32_t parent;
+    uint32_t type;
+    uint64_t nameOffset;
+    uint32_t nameLen;
+    uint32_t pad;
+    int64_t size;
 };
 
 class FS {
 private:
-    Entry root;
+    // Entries are allocated in blocks and never move, so Entry* stays valid.
+    deque<Entry> arena;
+    Entry* root;
+
+    // Child lookup for every directory, keyed by (directory, child name).
+    unordered_map<ChildKey<const Entry*>, Entry*, ChildKeyHash<const Entry*>> children;
+
+    Entry* newEntry(Entry* parent, const string& name, entry_type type, long long size)
+    {
+        arena.push_back({ name, type, parent, nullptr, nullptr, size, arena.size() });
+        Entry* ent = &arena.back();
+        if (parent != nullptr) {
+            ent->nextSibling = parent->firstChild;
+            parent->firstChild = ent;
+            children.emplace(ChildKey<const Entry*>{ parent, name }, ent);
+        }
+        return ent;
+    }
 
 public:
     FS() {
-        root.type = DirType;
-        root.name = "~";
-        root.data.d.parent = NULL;
-        root.data.d.entries = new vector<Entry*>;
-        root.data.d.totalSize = 0;
+        root = newEntry(nullptr, "~", DirType, 0);
     }
 
     Entry& getRoot()
     {
-        return root;
+        return *root;
     }
 
-    Entry& addDir(Entry &parent, const string& name)
+    Entry* findChild(Entry& dir, const string& name)
     {
-        cout << "--> Adding dir " << name << " to " << parent.name << endl;
-
-        Entry *newDir = new Entry();
-        newDir->type = DirType;
-        newDir->name = name;
-        newDir->data.d.parent = &parent;
-        newDir->data.d.entries = new vector<Entry*>;
-        newDir->data.d.totalSize = 0;
-        parent.data.d.entries->push_back(newDir);
-        cout << "    NEW: name = " << newDir->name << ", parent is " << newDir->data.d.parent->name << endl;
-        //dumpFs();
-        return *newDir;
+        auto it = children.find(ChildKey<const Entry*>{ &dir, name });
+        return it == children.end() ? nullptr : it->second;
     }
 
-    Entry &addFile(Entry &dir, const string &name, int size)
+    /**
+     * Adds a directory, or returns the existing entry if the name is already
+     * there (listing a directory twice is harmless).
+     */
+    Entry& addDir(Entry &parent, const string& name)
     {
-        cout << "--> Adding file " << name << ", size " << size <<  " to " << dir.name << " (" << &dir << ")" << endl;
-        Entry *ent = new Entry();
-        ent->type = FileType;
-        ent->name = name;
-        ent->data.f.size = size;
-        dir.data.d.entries->push_back(ent);
-
-        Entry* parent = &dir;
-        do {
-            //cout << "--> Updating dir (" << parent << "): " << parent->name << endl;
-            parent->data.d.totalSize += size;
-            parent = parent->data.d.parent;
-        } while (parent != NULL);
+        Entry* ent = findChild(parent, name);
+        if (ent != nullptr)
+            return *ent;
+        return *newEntry(&parent, name, DirType, 0);
+    }
 
-        //dumpFs();
-        return *ent;
+    /**
+     * Adds a file. Directory totals aren't touched here; they're computed in
+     * one pass by computeSizes() once the whole log is replayed.
+     */
+    Entry &addFile(Entry &dir, const string &name, long long size)
+    {
+        Entry* ent = findChild(dir, name);
+        if (ent != nullptr)
+            return *ent;
+        return *newEntry(&dir, name, FileType, size);
     }
 
+    /**
+     * Changes directory. A directory that wasn't listed yet is created, so a
+     * cd ahead of its ls still works.
+     */
     Entry& chDir(Entry& entry, const string& name)
     {
-//        Entry::Dir& dir = entry.data.d;
-        cout << "CHDIR " << name << " FROM " << entry.name << endl;
         if (name == "/") {
-            return root;
+            return *root;
         }
 
         if (name == "..") {
-            //cout << "    BACK TO " << entry.data.d.parent->name << endl;
-            return *entry.data.d.parent;
+            return entry.parent != nullptr ? *entry.parent : *root;
         }
 
-        for (Entry* ent : *entry.data.d.entries) {
-            //cout << "   SCANNING: " << ent->name << endl;
-            if (ent->type == DirType && ent->name == name) {
-                //cout << "DIR FOUND " << name << " (" << ent << ")" << endl;
-				//dumpFs();
-                return *ent;
-            }
+        return addDir(entry, name);
+    }
+
+    /**
+     * Fills in directory totals. Every entry is created after its parent, so
+     * walking the arena backwards adds each entry into its parent only after
+     * the entry's own total is complete: a post-order pass with no recursion,
+     * however deep the tree.
+     */
+    void computeSizes()
+    {
+        for (Entry& ent : arena) {
+            if (ent.type == DirType)
+                ent.size = 0;
+        }
+        for (auto it = arena.rbegin(); it != arena.rend(); ++it) {
+            if (it->parent != nullptr)
+                it->parent->size += it->size;
         }
-        cout << "NOT FOUND: " << name << endl;
-        dumpFs();
-        exit(0);
     }
 
-    void dumpNode(Entry* ent)
+    /**
+     * Merges another tree into this one, matching directories by their
+     * path from the root. The other tree's entries are in creation order,
+     * so each one's parent has already been mapped across. Names already
+     * present are kept, as with a repeated listing. Call computeSizes()
+     * afterwards.
+     */
+    void merge(const FS& other)
     {
-        string parent = (ent->data.d.parent != NULL) ? ent->data.d.parent->name : "";
+        unordered_map<const Entry*, Entry*> mapped;
+        mapped.reserve(other.arena.size());
+        mapped[other.root] = root;
+
+        for (const Entry& ent : other.arena) {
+            if (ent.parent == nullptr)
+                continue;
+
+            Entry& parent = *mapped[ent.parent];
+            if (ent.type == DirType)
+                mapped[&ent] = &addDir(parent, ent.name);
+            else
+                addFile(parent, ent.name, ent.size);
+        }
+    }
 
-        cout << endl << "DIR NODE (" << ent << "): " << ent->name << ", parent : " << parent << ", has "
-            << ent->data.d.entries->size() << " nodes, total size is " << ent->data.d.totalSize << endl;
-        for (Entry* sub : *ent->data.d.entries) {
-            cout << "    SUB (" << sub << "): " << sub->type << " " << sub->name << endl;
+    /**
+     * Writes the tree and its size index as a snapshot image (see
+     * SnapshotHeader), stamped with the log it came from. Call after
+     * computeSizes(). The image goes to a temporary file that is renamed
+     * over filename once complete, so a crash never leaves a half-written
+     * image under the real name. Returns false if it can't be written.
+     */
+    bool writeSnapshot(const string& filename, const SourceStamp& source) const
+    {
+        SizeIndex index = sizeIndex();
+        const vector<long long>& sizes = index.sortedSizes();
+        const vector<long long>& prefix = index.prefixSums();
+
+        vector<SnapshotNode> nodes;
+        nodes.reserve(arena.size());
+        string names;
+        for (const Entry& ent : arena) {
+            SnapshotNode node = { };
+            node.parent = ent.parent != nullptr ? (uint32_t)ent.parent->id : NO_PARENT;
+            node.type = ent.type;
+            node.nameOffset = names.size();
+            node.nameLen = (uint32_t)ent.name.size();
+            node.size = ent.size;
+            nodes.push_back(node);
+            names += ent.name;
         }
-        for (Entry* sub : *ent->data.d.entries) {
-            if (sub->type == DirType) {
-                dumpNode(sub);
-            }
+
+        SnapshotHeader hdr = { };
+        memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+        hdr.version = SNAPSHOT_VERSION;
+        hdr.numNodes = (uint32_t)nodes.size();
+        hdr.numDirs = sizes.size();
+        hdr.nodesOffset = sizeof(SnapshotHeader);
+        hdr.sizesOffset = hdr.nodesOffset + nodes.size() * sizeof(SnapshotNode);
+        hdr.prefixOffset = hdr.sizesOffset + sizes.size() * sizeof(int64_t);
+        hdr.namesOffset = hdr.prefixOffset + prefix.size() * sizeof(int64_t);
+        hdr.namesBytes = names.size();
+        hdr.sourceSize = source.size;
+        hdr.sourceTime = source.time;
+
+        string tmpName = filename + ".tmp";
+        ofstream out(tmpName, ios::binary | ios::trunc);
+        out.write((const char*)&hdr, sizeof(hdr));
+        out.write((const char*)nodes.data(), nodes.size() * sizeof(SnapshotNode));
+        for (long long v : sizes) {
+            int64_t x = v;
+            out.write((const char*)&x, sizeof(x));
+        }
+        for (long long v : prefix) {
+            int64_t x = v;
+            out.write((const char*)&x, sizeof(x));
         }
-        cout << endl;
+        out.write(names.data(), names.size());
+        out.close();
+        if (!out) {
+            remove(tmpName.c_str());
+            return false;
+        }
+
+#ifdef _WIN32
+        bool renamed = MoveFileExA(tmpName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        bool renamed = rename(tmpName.c_str(), filename.c_str()) == 0;
+#endif
+        if (!renamed)
+            remove(tmpName.c_str());
+        return renamed;
     }
 
-    void dumpFs()
+    size_t numEntries() const
     {
-        cout << "------------- DUMP" << endl << "ROOT: " << root.name << endl;
-        dumpNode(&root);
+        return arena.size();
     }
 
-    void findLess(Entry* ent, int &total) {
-	if (ent->data.d.totalSize < 100000) {
-	    cout << "Found " << ent->name << " total size is " << ent->data.d.totalSize << endl;
-            total += ent->data.d.totalSize;
-	}
-        for (Entry* sub : *ent->data.d.entries) {
-            if (sub->type == DirType) {
-                findLess(sub, total);
-            }
+    void dumpNode(Entry* ent, int depth)
+    {
+        cout << string(depth * 2, ' ') << "- " << ent->name;
+        if (ent->type == DirType)
+            cout << " (dir, total size " << ent->size << ")" << endl;
+        else
+            cout << " (file, size " << ent->size << ")" << endl;
+
+        for (Entry* sub = ent->firstChild; sub != nullptr; sub = sub->nextSibling) {
+            dumpNode(sub, depth + 1);
         }
     }
 
-    void findAll()
+    void dumpFs()
     {
-        int total = 0;
-        findLess(&root, total);
-
-        cout << "Grand total is " << total << endl;
+        cout << "------------- DUMP" << endl;
+        dumpNode(root, 0);
     }
 
-    void dsp(Entry* ent) {
-	cout << "Size " << ent->name << " total size is " << ent->data.d.totalSize << endl;
-        for (Entry* sub : *ent->data.d.entries) {
-            if (sub->type == DirType)
-                dsp(sub);
+    /**
+     * Builds the size index over every directory total. Call after
+     * computeSizes().
+     */
+    SizeIndex sizeIndex() const
+    {
+        vector<long long> sizes;
+        for (const Entry& ent : arena) {
+            if (ent.type == DirType)
+                sizes.push_back(ent.size);
         }
+        return SizeIndex(move(sizes));
     }
 
     void dspSizes()
     {
-        dsp(&root);
+        for (const Entry& ent : arena) {
+            if (ent.type == DirType)
+                cout << "Size " << ent.name << " total size is " << ent.size << endl;
+        }
+    }
+};
+
+/**
+ * Splits a log line at the first two spaces, without regex. The last token
+ * is the rest of the line. Returns the number of tokens.
+ */
+int splitLine(const string& s, string tokens[3])
+{
+    int n = 0;
+    size_t pos = 0;
+    while (n < 2) {
+        size_t sp = s.find(' ', pos);
+        if (sp == string::npos)
+            break;
+        tokens[n++].assign(s, pos, sp - pos);
+        pos = sp + 1;
+    }
+    tokens[n++].assign(s, pos, string::npos);
+    return n;
+}
+
+/**
+ * Log replay that keeps only directories: for each one its parent and the
+ * total of the files directly in it.
+ * File lines are added straight into the current directory's total and
+ * nothing is kept per file, so memory grows with the number of
+ * directories rather than the size of the log.
+ *
+ * Since files aren't remembered, a repeat listing of a directory replaces
+ * its earlier total rather than adding to it.
+ */
+class DirTotals {
+private:
+    struct Dir {
+        int parent;
+        long long size;
+    };
+
+    vector<Dir> dirs;
+    unordered_map<ChildKey<int>, int, ChildKeyHash<int>> children;
+    bool rolledUp = false;
+
+    int childDir(int dir, const string& name)
+    {
+        auto it = children.find(ChildKey<int>{ dir, name });
+        if (it != children.end())
+            return it->second;
+
+        int id = (int)dirs.size();
+        dirs.push_back({ dir, 0 });
+        children.emplace(ChildKey<int>{ dir, name }, id);
+        return id;
+    }
+
+public:
+    DirTotals()
+    {
+        dirs.push_back({ -1, 0 });
     }
 
-    void findIt(Entry* ent, int need, vector<Entry*>& nodes) {
-	if (ent->data.d.totalSize >= need) {
-	    cout << "Found " << ent->name << " total size is " << ent->data.d.totalSize << endl;
-            nodes.push_back(ent);
-	}
-        for (Entry* sub : *ent->data.d.entries) {
-            if (sub->type == DirType) {
-                findIt(sub, need, nodes);
+    void replay(istream& in)
+    {
+        string s;
+        string tokens[3];
+        int cur = 0;
+
+        while (getline(in, s)) {
+            if (!s.empty() && s.back() == '\r')
+                s.pop_back();
+            if (s.empty())
+                continue;
+
+            int n = splitLine(s, tokens);
+            if (tokens[0] == "$") {
+                if (n == 3 && tokens[1] == "cd") {
+                    if (tokens[2] == "/")
+                        cur = 0;
+                    else if (tokens[2] == "..")
+                        cur = dirs[cur].parent >= 0 ? dirs[cur].parent : 0;
+                    else
+                        cur = childDir(cur, tokens[2]);
+                } else if (n >= 2 && tokens[1] == "ls") {
+                    dirs[cur].size = 0;
+                }
+            } else if (n == 2 && tokens[0] == "dir") {
+                childDir(cur, tokens[1]);
+            } else if (n == 2) {
+                dirs[cur].size += stoll(tokens[0]);
             }
         }
+
+        rolledUp = false;
+    }
+
+    /**
+     * Turns direct file totals into full directory totals. Directories are
+     * numbered in the order they were first seen, always after their
+     * parent, so one backwards pass does it.
+     */
+    void rollUp()
+    {
+        if (rolledUp)
+            return;
+        for (size_t i = dirs.size(); i-- > 1; ) {
+            dirs[dirs[i].parent].size += dirs[i].size;
+        }
+        rolledUp = true;
     }
 
-    void findSmallest(int need) {
-        vector<Entry*> nodes;
-        findIt(&root, need, nodes);
+    size_t numDirs() const
+    {
+        return dirs.size();
+    }
 
-        sort(nodes.begin(), nodes.end(), [](const Entry* a, const Entry* b) {
-            return a->data.d.totalSize < b->data.d.totalSize;
-        });
-        //std::sort(nodes.begin(), nodes.end(), compare);
+    long long rootSize()
+    {
+        rollUp();
+        return dirs[0].size;
+    }
 
-        for (Entry* ent : nodes) {
-            cout << "Candidate: " << ent->name << ", size: " << ent->data.d.totalSize << endl;
+    SizeIndex sizeIndex()
+    {
+        rollUp();
+        vector<long long> sizes;
+        sizes.reserve(dirs.size());
+        for (const Dir& dir : dirs) {
+            sizes.push_back(dir.size);
         }
-
-        cout << "Smallest is: " << nodes[0]->data.d.totalSize << endl;
+        return SizeIndex(move(sizes));
     }
 };
 
-std::vector<std::string> str_split(const std::string& s, const char* pattern) {
-    std::regex sep_regex = std::regex{ pattern };
-    std::sregex_token_iterator iter(s.begin(), s.end(), sep_regex, -1);
-    std::sregex_token_iterator end;
-    return { iter, end };
+/**
+ * Applies one log line to the tree, moving curDir on a cd.
+ */
+void replayLine(FS& fs, Entry*& curDir, string& s, string tokens[3])
+{
+    if (!s.empty() && s.back() == '\r')
+        s.pop_back();
+    if (s.empty())
+        return;
+
+    int n = splitLine(s, tokens);
+    if (tokens[0] == "$") {
+        if (n == 3 && tokens[1] == "cd")
+            curDir = &fs.chDir(*curDir, tokens[2]);
+        // "ls" needs no state: anything that isn't a command is listing
+        // output for the current directory.
+    } else if (n == 2 && tokens[0] == "dir") {
+        fs.addDir(*curDir, tokens[1]);
+    } else if (n == 2) {
+        fs.addFile(*curDir, tokens[1], stoll(tokens[0]));
+    }
+}
+
+string readFile(const string& filename)
+{
+    ifstream in(filename, ios::binary);
+    string buf;
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    if (size <= 0)
+        return buf;
+    buf.resize((size_t)size);
+    in.seekg(0, ios::beg);
+    in.read(&buf[0], size);
+    return buf;
+}
+
+/**
+ * Picks up to parts segment starts in the log, each at a "$ cd /" line so
+ * every segment begins at the root no matter what came before it. The
+ * first segment starts at 0; the others are the first "$ cd /" at or after
+ * each even split of the byte length.
+ */
+vector<size_t> splitAtRoot(const string& log, int parts)
+{
+    const string cdRoot = "$ cd /";
+    vector<size_t> starts{ 0 };
+
+    for (int p = 1; p < parts; ++p) {
+        size_t pos = log.length() / parts * p;
+        if (pos <= starts.back())
+            pos = starts.back() + 1;
+
+        // Back up to the start of the line, then look forward for cd /.
+        pos = log.rfind('\n', pos - 1);
+        pos = pos == string::npos ? 0 : pos + 1;
+        while (pos < log.length()) {
+            size_t eol = log.find('\n', pos);
+            if (eol == string::npos)
+                eol = log.length();
+            size_t len = eol - pos;
+            if (len > 0 && log[eol - 1] == '\r')
+                --len;
+            if (len == cdRoot.length() && log.compare(pos, len, cdRoot) == 0)
+                break;
+            pos = eol + 1;
+        }
+
+        if (pos >= log.length())
+            break;
+        if (pos > starts.back())
+            starts.push_back(pos);
+    }
+
+    return starts;
+}
+
+/**
+ * Replays the log across threads. It's split at "$ cd /" lines, each
+ * segment is replayed into its own partial tree starting at the root, and
+ * the partial trees are then merged in log order into one filesystem.
+ */
+void day7_parallel(int part, const string& filename = "log.txt",
+    int numThreads = max((int)thread::hardware_concurrency(), 1))
+{
+    string log = readFile(filename);
+    vector<size_t> starts = splitAtRoot(log, numThreads);
+    starts.push_back(log.length());
+
+    size_t numSegments = starts.size() - 1;
+    vector<FS> partials(numSegments);
+
+    auto work = [&](size_t seg) {
+        FS& fs = partials[seg];
+        Entry* curDir = &fs.getRoot();
+        string s;
+        string tokens[3];
+        size_t pos = starts[seg];
+        while (pos < starts[seg + 1]) {
+            size_t eol = log.find('\n', pos);
+            if (eol == string::npos || eol > starts[seg + 1])
+                eol = starts[seg + 1];
+            s.assign(log, pos, eol - pos);
+            replayLine(fs, curDir, s, tokens);
+            pos = eol + 1;
+        }
+    };
+
+    vector<thread> pool;
+    for (size_t seg = 1; seg < numSegments; ++seg) {
+        pool.emplace_back(work, seg);
+    }
+    work(0);
+    for (thread& t : pool) {
+        t.join();
+    }
+
+    FS& fs = partials[0];
+    for (size_t seg = 1; seg < numSegments; ++seg) {
+        fs.merge(partials[seg]);
+    }
+    fs.computeSizes();
+
+    SizeIndex index = fs.sizeIndex();
+    cout << numSegments << " segments, " << fs.numEntries() << " entries" << endl;
+    if (part == 1)
+        cout << "Grand total is " << index.sumAtMost(100000) << endl;
+
+    long long needSize = 30000000 - (70000000 - fs.getRoot().size);
+    cout << "Need size is " << needSize << endl;
+    cout << "Smallest is: " << index.smallestAtLeast(needSize) << endl;
 }
 
+/**
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const string& filename)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            close();
+            return false;
+        }
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)size.QuadPart;
+#else
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close();
+            return false;
+        }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        base = p == MAP_FAILED ? nullptr : (const char*)p;
+        length = (size_t)st.st_size;
+#endif
+        if (base == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (base != nullptr)
+            UnmapViewOfFile(base);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base != nullptr)
+            munmap((void*)base, length);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    const char* data() const
+    {
+        return base;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+};
+
+/**
+ * A snapshot image mapped into memory. Queries read the mapped arrays in
+ * place; nothing is parsed or rebuilt on load.
+ */
+class FSSnapshot {
+private:
+    MappedFile image;
+    const SnapshotHeader* hdr = nullptr;
+    const SnapshotNode* nodes = nullptr;
+    const int64_t* sizes = nullptr;
+    const int64_t* prefix = nullptr;
+    const char* names = nullptr;
+
+public:
+    /**
+     * Maps the image and checks that it's a snapshot of this version, built
+     * from a log matching source, whose sections all fit in the file and
+     * whose nodes only point at names and parents inside it. On failure the
+     * image is unmapped and closed again, so it can be rebuilt in place.
+     */
+    bool open(const string& filename, const SourceStamp& source)
+    {
+        hdr = nullptr;
+        if (!image.open(filename))
+            return false;
+
+        const char* base = image.data();
+        size_t len = image.size();
+        if (len < sizeof(SnapshotHeader)) {
+            image.close();
+            return false;
+        }
+
+        const SnapshotHeader* h = (const SnapshotHeader*)base;
+        if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->version != SNAPSHOT_VERSION
+            || h->numNodes == 0 || h->numDirs == 0
+            || h->nodesOffset != sizeof(SnapshotHeader)
+            || h->sizesOffset != h->nodesOffset + (uint64_t)h->numNodes * sizeof(SnapshotNode)
+            || h->prefixOffset != h->sizesOffset + h->numDirs * sizeof(int64_t)
+            || h->namesOffset != h->prefixOffset + (h->numDirs + 1) * sizeof(int64_t)
+            || h->namesOffset + h->namesBytes != len
+            || h->sourceSize != source.size || h->sourceTime != source.time) {
+            image.close();
+            return false;
+        }
+
+        const SnapshotNode* n = (const SnapshotNode*)(base + h->nodesOffset);
+        for (size_t i = 0; i < h->numNodes; ++i) {
+            if ((n[i].parent != NO_PARENT && n[i].parent >= h->numNodes)
+                || n[i].nameOffset > h->namesBytes
+                || n[i].nameLen > h->namesBytes - n[i].nameOffset) {
+                image.close();
+                return false;
+            }
+        }
+
+        hdr = h;
+        nodes = n;
+        sizes = (const int64_t*)(base + h->sizesOffset);
+        prefix = (const int64_t*)(base + h->prefixOffset);
+        names = base + h->namesOffset;
+        return true;
+    }
+
+    size_t numNodes() const
+    {
+        return hdr->numNodes;
+    }
+
+    size_t numDirs() const
+    {
+        return (size_t)hdr->numDirs;
+    }
+
+    string name(size_t node) const
+    {
+        return string(names + nodes[node].nameOffset, nodes[node].nameLen);
+    }
+
+    long long rootSize() const
+    {
+        return nodes[0].size;
+    }
+
+    long long sumAtMost(long long limit) const
+    {
+        size_t n = upper_bound(sizes, sizes + numDirs(), (int64_t)limit) - sizes;
+        return prefix[n];
+    }
+
+    long long smallestAtLeast(long long need) const
+    {
+        const int64_t* it = lower_bound(sizes, sizes + numDirs(), (int64_t)need);
+        return it == sizes + numDirs() ? -1 : *it;
+    }
+};
+
 /**
  * Part 1: Reads input from a file representing filesystem commands and
  * structure, builds a representation of the filesystem, and then finds
@@ -228,80 +911,100 @@ std::vector<std::string> str_split(const std::string& s, const char* pattern) {
  * This involves calculating the free space, determining the additional space
  * needed, and identifying the smallest directory that meets this requirement.
  */
-void day7_run(int part)
+void day7_run(int part, const string& filename = "log.txt")
 {
     string s;
-    string q;
+    string tokens[3];
     FS fs;
     Entry* curDir = &fs.getRoot();
-    enum { st_normal, st_ls } state = st_normal;
 
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
     ifstream in;
-    in.open("log.txt");
+    in.open(filename);
 
     while (getline(in, s)) {
-        cout << s << endl;
-        vector<string> tokens = str_split(s, " ");
-
-        for (;;) {
-            switch (state) {
-            case st_normal:
-		if (tokens[0] == "$") {
-		    string cmd = tokens[1];
-		    cout << "command: " << cmd << endl;
-                    if (cmd == "cd") {
-                        curDir = &fs.chDir(*curDir, tokens[2]);
-                        cout << "DID CHDIR, is now " << curDir->name << " (" << curDir << ")" << endl;
-                    } else if (cmd == "ls") {
-                        state = st_ls;
-                    }
-		}
+        replayLine(fs, curDir, s, tokens);
+    }
 
-                break;
-            case st_ls:
-                if (tokens[0] == "$") {
-                    state = st_normal;
-                    continue;
-                }
+    fs.computeSizes();
+    SizeIndex index = fs.sizeIndex();
 
-                if (tokens[0] == "dir") {
-		    fs.addDir(*curDir, tokens[1]);
-                    break;
-                }
+    // Part 1
+    if (part == 1)
+        cout << "Grand total is " << index.sumAtMost(100000) << endl;
 
-                cout << "LS state, s is " << s << endl;
-                cout << "tokens[0] is " << tokens[0] << endl;
+    // Part 2
+    if (part == 2)
+        fs.dspSizes();
 
-                int size = stoi(tokens[0]);
-                string name = tokens[1];
-                cout << "ls mode: " << name << ": " << size << endl;
-                fs.addFile(*curDir, name, size);
-                break;
-            }
+    Entry* root = &fs.getRoot();
+    long long freeSpace = 70000000 - root->size;
+    long long updSize = 30000000;
+    long long needSize = updSize - freeSpace;
+    cout << "Need size is " << needSize << endl;
+    cout << "Smallest is: " << index.smallestAtLeast(needSize) << endl;
+}
 
-            break;
-        }
-        cout << "0: " << tokens[0] << endl;
+/**
+ * Same answers as day7_run, using the streaming DirTotals replay instead of
+ * building the full tree.
+ */
+void day7_stream(int part, const string& filename = "log.txt")
+{
+    DirTotals totals;
+    ifstream in;
+    in.open(filename);
+    totals.replay(in);
 
+    SizeIndex index = totals.sizeIndex();
+    if (part == 1)
+        cout << "Grand total is " << index.sumAtMost(100000) << endl;
+
+    long long needSize = 30000000 - (70000000 - totals.rootSize());
+    cout << "Need size is " << needSize << endl;
+    cout << "Smallest is: " << index.smallestAtLeast(needSize) << endl;
+}
+
+/**
+ * Answers both parts from a snapshot image of the log's filesystem. If the
+ * image is missing, unreadable, or was built from a log of a different size
+ * or modification time, the log is replayed once and the image rewritten;
+ * later runs just map it.
+ */
+void day7_snapshot(const string& logName = "log.txt", const string& imageName = "log.fsimg")
+{
+    SourceStamp source;
+    if (!statSource(logName, source)) {
+        cout << "Could not read " << logName << endl;
+        return;
     }
 
-    fs.dumpFs();
+    FSSnapshot snap;
+    if (!snap.open(imageName, source)) {
+        cout << "Building snapshot " << imageName << " from " << logName << endl;
+
+        FS fs;
+        Entry* curDir = &fs.getRoot();
+        string s;
+        string tokens[3];
+        ifstream in;
+        in.open(logName);
+        while (getline(in, s)) {
+            replayLine(fs, curDir, s, tokens);
+        }
+        fs.computeSizes();
 
-    // Part 1
-    if (part == 1)
-	fs.findAll();
+        if (!fs.writeSnapshot(imageName, source) || !snap.open(imageName, source)) {
+            cout << "Could not write snapshot " << imageName << endl;
+            return;
+        }
+    }
 
-    // Part 2
-    if (part == 2)
-	fs.dspSizes();
+    cout << "Snapshot has " << snap.numNodes() << " entries, " << snap.numDirs() << " directories" << endl;
+    cout << "Grand total is " << snap.sumAtMost(100000) << endl;
 
-    Entry* root = &fs.getRoot();
-    int freeSpace = 70000000 - root->data.d.totalSize;
-    int updSize = 30000000;
-    int needSize = updSize - freeSpace;
+    long long needSize = 30000000 - (70000000 - snap.rootSize());
     cout << "Need size is " << needSize << endl;
-    fs.findSmallest(needSize);
+    cout << "Smallest is: " << snap.smallestAtLeast(needSize) << endl;
 }
 
 int main()
@@ -13,106 +13,647 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <set>
 #include <algorithm>
-#include <map>
-#include <regex>
-#include <queue>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <random>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-enum entry_type { DirType, FileType };
+typedef chrono::high_resolution_clock Clock;
 
 /**
- * Part 1: Calculates and prints the number of visible trees in the grid.
- * Visibility is determined by checking each tree's height against other trees
- * in the same row and column. Trees are considered visible if no other tree
- * of equal or greater height blocks them when viewed from the grid's edges.
+ * Tree heights packed one byte per tree, twice: row-major in heights, where a
+ * tree at (r, c) is heights[r * cols + c], and column-major in transposed,
+ * where it's transposed[c * rows + r]. Every sweep below walks whichever copy
+ * keeps its lines contiguous.
  */
-void day8_part1()
+struct Forest {
+    int rows = 0;
+    int cols = 0;
+    string heights;
+    string transposed;
+};
+
+/**
+ * Runs work(first, last) over lines [0, count) split into contiguous ranges,
+ * one per thread. Small grids aren't worth the thread startup and run inline.
+ */
+template <typename Work>
+void runParallel(int count, int numThreads, Work work)
 {
-    string s;
-    string q;
+    const int minPerThread = 64;
+    int threads = min(max(numThreads, 1), max(count / minPerThread, 1));
+    if (threads == 1) {
+        work(0, count);
+        return;
+    }
 
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
+    vector<thread> pool;
+    int per = (count + threads - 1) / threads;
+    for (int first = 0; first < count; first += per) {
+        int last = min(first + per, count);
+        pool.emplace_back(work, first, last);
+    }
+    for (thread& t : pool) {
+        t.join();
+    }
+}
+
+int defaultThreads()
+{
+    return max((int)thread::hardware_concurrency(), 1);
+}
+
+const int TILE = 32;
+const int HEIGHTS = 10;
+const int SCORE_BLOCK = 64;
+const size_t NO_TREE = (size_t)-1;
+
+/**
+ * Calls fn(r, c) for every cell of a rows x cols grid, a TILE x TILE block at
+ * a time, so code that reads one layout and writes the other touches a few
+ * cache lines per block instead of one per cell. Bands of tile rows are
+ * split across threads.
+ */
+template <typename Fn>
+void forEachTiled(int rows, int cols, int numThreads, Fn fn)
+{
+    int bands = (rows + TILE - 1) / TILE;
+    runParallel(bands, numThreads, [&](int first, int last) {
+        for (int band = first; band < last; ++band) {
+            int rowEnd = min((band + 1) * TILE, rows);
+            for (int c0 = 0; c0 < cols; c0 += TILE) {
+                int colEnd = min(c0 + TILE, cols);
+                for (int r = band * TILE; r < rowEnd; ++r) {
+                    for (int c = c0; c < colEnd; ++c) {
+                        fn(r, c);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Reads the forest map, one row of digit heights per line. Rows must all be
+ * the same length, and heights must be digits since the distance sweeps keep
+ * one slot per height.
+ */
+Forest loadForest(const string& filename, int numThreads = defaultThreads())
+{
+    string s;
     ifstream in;
-    in.open("trees.txt");
+    in.open(filename);
 
-    vector<string> trees;
+    Forest forest;
     while (getline(in, s)) {
-        trees.push_back(s);
-    }
-
-    int numLines = trees.size();
-    int visible = 0;
-    for (int r = 0; r < numLines; ++r) {
-        string row = trees[r];
-        cout << row << endl;
-        for (int c = 0; c < row.length(); ++c) {
-            char ht = row[c];
-            cout << "Checking r=" << r << ", c=" << c << " ht is " << ht << endl;
-
-            bool vis = 1;
-            for (int left = c - 1; left >= 0; --left) {
-                //cout << "    left chk, left = " << left << ", ht = " << ht << ", tree = " << row[left] << endl;
-                if (row[left] >= ht) {
-                    //cout << "NOT VISIBLE" << endl;
-                    vis = 0;
-                    break;
-                }
+        if (!s.empty() && s.back() == '\r')
+            s.pop_back();
+        if (s.empty())
+            continue;
+        if (forest.rows == 0) {
+            forest.cols = s.length();
+        } else if ((int)s.length() != forest.cols) {
+            cout << "Row " << forest.rows << " is " << s.length() << " wide, expected " << forest.cols << endl;
+            exit(0);
+        }
+        if (s.find_first_not_of("0123456789") != string::npos) {
+            cout << "Row " << forest.rows << " has a height that isn't a digit" << endl;
+            exit(0);
+        }
+        forest.heights += s;
+        ++forest.rows;
+    }
+
+    int rows = forest.rows;
+    int cols = forest.cols;
+    forest.transposed.resize(forest.heights.size());
+    forEachTiled(rows, cols, numThreads, [&](int r, int c) {
+        forest.transposed[(size_t)c * rows + r] = forest.heights[(size_t)r * cols + c];
+    });
+    return forest;
+}
+
+/**
+ * Marks trees in columns [firstCol, lastCol) of a numRows x width byte grid
+ * that are visible from the top edge, or from the bottom edge if fromBottom.
+ * Each column keeps a running maximum while the sweep steps a row at a time,
+ * so every step reads one contiguous run of the row. With AVX2 that's 32
+ * columns per compare; leftover columns run the same loop a byte at a time.
+ */
+void sweepVisible(const char* grid, char* vis, int numRows, int width, int firstCol, int lastCol,
+    bool fromBottom)
+{
+    int n = lastCol - firstCol;
+    vector<char> tallest(n, 0);
+
+    for (int i = 0; i < numRows; ++i) {
+        size_t rowStart = (size_t)(fromBottom ? numRows - 1 - i : i) * width + firstCol;
+        const char* ht = grid + rowStart;
+        char* seen = vis + rowStart;
+        int j = 0;
+#ifdef __AVX2__
+        const __m256i one = _mm256_set1_epi8(1);
+        for (; j + 32 <= n; j += 32) {
+            __m256i h = _mm256_loadu_si256((const __m256i*)(ht + j));
+            __m256i t = _mm256_loadu_si256((const __m256i*)(tallest.data() + j));
+            __m256i taller = _mm256_and_si256(_mm256_cmpgt_epi8(h, t), one);
+            __m256i v = _mm256_loadu_si256((const __m256i*)(seen + j));
+            _mm256_storeu_si256((__m256i*)(seen + j), _mm256_or_si256(v, taller));
+            _mm256_storeu_si256((__m256i*)(tallest.data() + j), _mm256_max_epi8(t, h));
+        }
+#endif
+        for (; j < n; ++j) {
+            if (ht[j] > tallest[j]) {
+                seen[j] = 1;
+                tallest[j] = ht[j];
             }
-            if (vis) {
-                ++visible;
-                cout << "coord " << r << ", " << c << " is visible from left (" << visible << ")" << endl;
-                continue;
+        }
+    }
+}
+
+/**
+ * Runs sweepVisible from both ends of a numRows x width grid. Threads are
+ * handed bands of whole 32-column strips so the vector loop never splits.
+ */
+void sweepVisibleBoth(const string& grid, vector<char>& vis, int numRows, int width, int numThreads)
+{
+    int strips = (width + 31) / 32;
+    runParallel(strips, numThreads, [&](int first, int last) {
+        int firstCol = first * 32;
+        int lastCol = min(last * 32, width);
+        sweepVisible(grid.data(), vis.data(), numRows, width, firstCol, lastCol, false);
+        sweepVisible(grid.data(), vis.data(), numRows, width, firstCol, lastCol, true);
+    });
+}
+
+/**
+ * Part 1 count: a tree is visible if it's taller than everything between it
+ * and some edge. Top and bottom sweeps run down the columns of the row-major
+ * grid; left and right sweeps run down the columns of the transposed grid.
+ * The two visibility maps are OR'd tile by tile. O(R*C) total.
+ */
+int countVisible(const Forest& forest, int numThreads = defaultThreads())
+{
+    int rows = forest.rows;
+    int cols = forest.cols;
+    vector<char> vis((size_t)rows * cols, 0);
+    if (vis.empty())
+        return 0;
+
+    vector<char> visT(vis.size(), 0);
+    sweepVisibleBoth(forest.heights, vis, rows, cols, numThreads);
+    sweepVisibleBoth(forest.transposed, visT, cols, rows, numThreads);
+
+    forEachTiled(rows, cols, numThreads, [&](int r, int c) {
+        vis[(size_t)r * cols + c] |= visT[(size_t)c * rows + r];
+    });
+    return count(vis.begin(), vis.end(), 1);
+}
+
+/**
+ * Multiplies each tree's score by its viewing distance looking back toward
+ * the start of its line, for lines [firstLine, lastLine) of a grid whose
+ * lines are lineLen bytes and stored back to back. fromEnd sweeps each line
+ * right to left instead.
+ *
+ * For every height the sweep remembers the last tree at least that tall, so
+ * a tree's view stops at blocker[height], and the tree then becomes the
+ * blocker for every height up to its own. The edge acts as a blocker at the
+ * first tree. With AVX2 the ten blockers sit in two registers, so the lookup
+ * is a permute and the update is a pair of blends, with no branches at all.
+ */
+void sweepDistance(const char* grid, long long* score, int firstLine, int lastLine, int lineLen,
+    bool fromEnd)
+{
+    int step = fromEnd ? -1 : 1;
+    for (int line = firstLine; line < lastLine; ++line) {
+        const char* heights = grid + (size_t)line * lineLen;
+        long long* lineScore = score + (size_t)line * lineLen;
+        int at = fromEnd ? lineLen - 1 : 0;
+#ifdef __AVX2__
+        const __m256i levelsLow = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i levelsHigh = _mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15);
+        const __m256i seven = _mm256_set1_epi32(7);
+        __m256i blockLow = _mm256_setzero_si256();
+        __m256i blockHigh = _mm256_setzero_si256();
+        for (int i = 0; i < lineLen; ++i, at += step) {
+            int ht = heights[at] - '0';
+            __m256i h = _mm256_set1_epi32(ht);
+            __m256i low = _mm256_permutevar8x32_epi32(blockLow, h);
+            __m256i high = _mm256_permutevar8x32_epi32(blockHigh, h);
+            __m256i blocker = _mm256_blendv_epi8(low, high, _mm256_cmpgt_epi32(h, seven));
+            lineScore[at] *= i - _mm256_cvtsi256_si32(blocker);
+
+            __m256i pos = _mm256_set1_epi32(i);
+            __m256i upTo = _mm256_set1_epi32(ht + 1);
+            blockLow = _mm256_blendv_epi8(blockLow, pos, _mm256_cmpgt_epi32(upTo, levelsLow));
+            blockHigh = _mm256_blendv_epi8(blockHigh, pos, _mm256_cmpgt_epi32(upTo, levelsHigh));
+        }
+#else
+        int blocker[HEIGHTS] = { 0 };
+        for (int i = 0; i < lineLen; ++i, at += step) {
+            int ht = heights[at] - '0';
+            lineScore[at] *= i - blocker[ht];
+            for (int k = 0; k < HEIGHTS; ++k) {
+                blocker[k] = k <= ht ? i : blocker[k];
             }
+        }
+#endif
+    }
+}
 
-            vis = 1;
-            for (int right = c + 1; right < row.length(); ++right) {
-                if (row[right] >= ht) {
-                    vis = 0;
-                    break;
+/**
+ * Runs sweepDistance both ways along every line of a grid, split across
+ * threads.
+ */
+void sweepDistanceBoth(const string& grid, vector<long long>& score, int numLines, int lineLen,
+    int numThreads)
+{
+    runParallel(numLines, numThreads, [&](int first, int last) {
+        sweepDistance(grid.data(), score.data(), first, last, lineLen, false);
+        sweepDistance(grid.data(), score.data(), first, last, lineLen, true);
+    });
+}
+
+/**
+ * Scenic score of every tree, row-major: the product of its viewing
+ * distances in the four directions, O(R*C). Left and right distances are
+ * swept along the rows of the row-major grid straight into the scores. Up
+ * and down distances are swept along the rows of the transposed grid, TILE
+ * columns at a time into a small per-thread buffer, which is then folded
+ * into the scores a row at a time.
+ */
+vector<long long> scenicScores(const Forest& forest, int numThreads = defaultThreads())
+{
+    int rows = forest.rows;
+    int cols = forest.cols;
+    vector<long long> score((size_t)rows * cols, 1);
+    if (score.empty())
+        return score;
+
+    sweepDistanceBoth(forest.heights, score, rows, cols, numThreads);
+
+    int bands = (cols + TILE - 1) / TILE;
+    runParallel(bands, numThreads, [&](int first, int last) {
+        vector<long long> vertical((size_t)TILE * rows);
+        for (int band = first; band < last; ++band) {
+            int firstCol = band * TILE;
+            int n = min(TILE, cols - firstCol);
+            const char* lines = forest.transposed.data() + (size_t)firstCol * rows;
+            fill(vertical.begin(), vertical.end(), 1);
+            sweepDistance(lines, vertical.data(), 0, n, rows, false);
+            sweepDistance(lines, vertical.data(), 0, n, rows, true);
+
+            for (int r = 0; r < rows; ++r) {
+                long long* rowScore = &score[(size_t)r * cols + firstCol];
+                for (int j = 0; j < n; ++j) {
+                    rowScore[j] *= vertical[(size_t)j * rows + r];
                 }
             }
-            if (vis) {
-                ++visible;
-                cout << "coord " << r << ", " << c << " is visible from right (" << visible << ")" << endl;
-                continue;
-            }
+        }
+    });
+    return score;
+}
+
+struct ScenicTree {
+    long long score;
+    int row;
+    int col;
+};
+
+/**
+ * Orders trees best first: higher score, then earlier in row-major order so
+ * ties come out the same however the grid was split across threads.
+ */
+bool betterScenic(const ScenicTree& a, const ScenicTree& b)
+{
+    if (a.score != b.score)
+        return a.score > b.score;
+    return a.row != b.row ? a.row < b.row : a.col < b.col;
+}
+
+/**
+ * The k highest scoring trees, best first. Each thread scans a band of rows
+ * into a k-entry heap whose front is the worst tree kept, so most trees cost
+ * one compare against it and nothing is allocated per tree. Each thread
+ * hands its heap over once it's done and the survivors are sorted at the end.
+ */
+vector<ScenicTree> topScenic(const vector<long long>& score, int cols, size_t k,
+    int numThreads = defaultThreads())
+{
+    if (k == 0 || cols == 0 || score.empty())
+        return vector<ScenicTree>();
 
-            vis = 1;
-            for (int up = r - 1; up >= 0; --up) {
-                if (trees[up][c] >= ht) {
-                    vis = 0;
-                    break;
+    vector<ScenicTree> best;
+    mutex bestLock;
+    int rows = score.size() / cols;
+
+    runParallel(rows, numThreads, [&](int first, int last) {
+        vector<ScenicTree> heap;
+        heap.reserve(k);
+        for (int r = first; r < last; ++r) {
+            const long long* line = &score[(size_t)r * cols];
+            for (int c = 0; c < cols; ++c) {
+                // Scanning in row-major order, an equal score is never better
+                if (heap.size() == k && line[c] <= heap.front().score)
+                    continue;
+                ScenicTree tree = { line[c], r, c };
+                if (heap.size() == k) {
+                    pop_heap(heap.begin(), heap.end(), betterScenic);
+                    heap.back() = tree;
+                } else {
+                    heap.push_back(tree);
                 }
+                push_heap(heap.begin(), heap.end(), betterScenic);
             }
-            if (vis) {
-                ++visible;
-                cout << "coord " << r << ", " << c << " is visible from up (" << visible << ")" << endl;
-                continue;
+        }
+
+        lock_guard<mutex> guard(bestLock);
+        best.insert(best.end(), heap.begin(), heap.end());
+    });
+
+    size_t keep = min(k, best.size());
+    partial_sort(best.begin(), best.begin() + keep, best.end(), betterScenic);
+    best.resize(keep);
+    return best;
+}
+
+/**
+ * A forest whose tree heights can be edited, with the visible count and the
+ * best scenic score kept current after every edit.
+ *
+ * A tree's left/right result only depends on its row, and its up/down
+ * result only on its column, so both halves are cached separately: left and
+ * right distances multiplied together per tree in row-major order, up and
+ * down in column-major order, and visibility from either side of the row or
+ * the column. An edit at (r, c) re-runs the sweeps for row r and column c
+ * only, O(R+C), and refreshes just those trees.
+ *
+ * The best score comes from a max tree over blocks of SCORE_BLOCK trees in
+ * row-major order. The edited row's blocks are rescanned. Every other block
+ * holding a changed column tree is rescanned too if its recorded best was
+ * one of them; if not, that best still stands and only the changed trees
+ * are compared against it.
+ */
+class ForestEditor {
+private:
+    Forest forest;
+    vector<long long> across;       // left * right distance, row-major
+    vector<long long> upDown;       // up * down distance, column-major
+    vector<char> visAcross;         // visible from the left or right, column-major
+    vector<char> visUpDown;         // visible from the top or bottom, row-major
+    vector<long long> score;        // row-major
+    long long numVisible = 0;
+
+    // Heap-ordered tree: node i covers nodes 2i and 2i+1, and the leaves
+    // from numLeaves on are blocks. Each node holds the best tree below it.
+    size_t numLeaves = 1;
+    vector<size_t> best;
+
+    size_t at(int r, int c) const
+    {
+        return (size_t)r * forest.cols + c;
+    }
+
+    size_t atT(int r, int c) const
+    {
+        return (size_t)c * forest.rows + r;
+    }
+
+    bool better(size_t a, size_t b) const
+    {
+        return score[a] != score[b] ? score[a] > score[b] : a < b;
+    }
+
+    /**
+     * Rebuilds one tree's score from its cached halves and counts it if
+     * it's visible.
+     */
+    void rescore(int r, int c)
+    {
+        score[at(r, c)] = across[at(r, c)] * upDown[atT(r, c)];
+        numVisible += isVisible(r, c);
+    }
+
+    void rescanBlock(size_t block)
+    {
+        size_t first = block * SCORE_BLOCK;
+        size_t last = min(first + SCORE_BLOCK, score.size());
+        size_t top = first;
+        for (size_t i = first + 1; i < last; ++i) {
+            if (better(i, top))
+                top = i;
+        }
+
+        best[numLeaves + block] = top;
+        pullUp(numLeaves + block);
+    }
+
+    void pullUp(size_t node)
+    {
+        for (node /= 2; node > 0; node /= 2) {
+            size_t left = best[2 * node];
+            size_t right = best[2 * node + 1];
+            best[node] = right != NO_TREE && (left == NO_TREE || better(right, left)) ? right : left;
+        }
+    }
+
+    /**
+     * Updates the max tree after every tree in column c outside row r was
+     * rescored; row r's blocks must already be rescanned. Trees are handled
+     * a block at a time, since a forest narrower than SCORE_BLOCK puts
+     * several of them in one block. If the block's recorded best was one of
+     * them its score is stale, so the block is rescanned. Otherwise the
+     * recorded best is unchanged and still beats every other untouched
+     * tree, so only the changed trees need comparing against it.
+     */
+    void updateColumn(int r, int c)
+    {
+        size_t firstRowBlock = at(r, 0) / SCORE_BLOCK;
+        size_t lastRowBlock = at(r, forest.cols - 1) / SCORE_BLOCK;
+        int rr = 0;
+        while (rr < forest.rows) {
+            size_t block = at(rr, c) / SCORE_BLOCK;
+            int end = rr;
+            while (end < forest.rows && at(end, c) / SCORE_BLOCK == block) {
+                ++end;
             }
 
-            vis = 1;
-            for (int down = r + 1; down < numLines; ++down) {
-                //cout << "    down chk, down = " << down << ", ht = " << ht << ", tree = " << trees[down][c] << endl;
-                if (trees[down][c] >= ht) {
-                    //cout << "NOT VISIBLE" << endl;
-                    vis = 0;
-                    break;
+            if (block < firstRowBlock || block > lastRowBlock) {
+                size_t leaf = numLeaves + block;
+                size_t top = best[leaf];
+                if (top % forest.cols == (size_t)c) {
+                    rescanBlock(block);
+                } else {
+                    for (; rr < end; ++rr) {
+                        if (better(at(rr, c), top))
+                            top = at(rr, c);
+                    }
+                    if (top != best[leaf]) {
+                        best[leaf] = top;
+                        pullUp(leaf);
+                    }
                 }
             }
-            if (vis) {
-                ++visible;
-                cout << "coord " << r << ", " << c << " is visible from down (" << visible << ")" << endl;
-                continue;
+            rr = end;
+        }
+    }
+
+    void sweepRow(int r)
+    {
+        int cols = forest.cols;
+        fill(&across[at(r, 0)], &across[at(r, 0)] + cols, 1);
+        sweepDistance(forest.heights.data(), across.data(), r, r + 1, cols, false);
+        sweepDistance(forest.heights.data(), across.data(), r, r + 1, cols, true);
+
+        for (int c = 0; c < cols; ++c) {
+            visAcross[atT(r, c)] = 0;
+        }
+        sweepVisible(forest.transposed.data(), visAcross.data(), cols, forest.rows, r, r + 1, false);
+        sweepVisible(forest.transposed.data(), visAcross.data(), cols, forest.rows, r, r + 1, true);
+    }
+
+    void sweepColumn(int c)
+    {
+        int rows = forest.rows;
+        fill(&upDown[atT(0, c)], &upDown[atT(0, c)] + rows, 1);
+        sweepDistance(forest.transposed.data(), upDown.data(), c, c + 1, rows, false);
+        sweepDistance(forest.transposed.data(), upDown.data(), c, c + 1, rows, true);
+
+        for (int r = 0; r < rows; ++r) {
+            visUpDown[at(r, c)] = 0;
+        }
+        sweepVisible(forest.heights.data(), visUpDown.data(), rows, forest.cols, c, c + 1, false);
+        sweepVisible(forest.heights.data(), visUpDown.data(), rows, forest.cols, c, c + 1, true);
+    }
+
+public:
+    ForestEditor(const Forest& start, int numThreads = defaultThreads())
+        : forest(start)
+    {
+        int rows = forest.rows;
+        int cols = forest.cols;
+        size_t trees = forest.heights.size();
+        across.assign(trees, 1);
+        upDown.assign(trees, 1);
+        visAcross.assign(trees, 0);
+        visUpDown.assign(trees, 0);
+        score.assign(trees, 0);
+
+        sweepDistanceBoth(forest.heights, across, rows, cols, numThreads);
+        sweepDistanceBoth(forest.transposed, upDown, cols, rows, numThreads);
+        sweepVisibleBoth(forest.heights, visUpDown, rows, cols, numThreads);
+        sweepVisibleBoth(forest.transposed, visAcross, cols, rows, numThreads);
+        forEachTiled(rows, cols, numThreads, [&](int r, int c) {
+            score[at(r, c)] = across[at(r, c)] * upDown[atT(r, c)];
+        });
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                numVisible += isVisible(r, c);
             }
+        }
+
+        size_t blocks = (trees + SCORE_BLOCK - 1) / SCORE_BLOCK;
+        while (numLeaves < blocks) {
+            numLeaves *= 2;
+        }
+        best.assign(2 * numLeaves, NO_TREE);
+        for (size_t b = 0; b < blocks; ++b) {
+            rescanBlock(b);
+        }
+    }
+
+    /**
+     * Changes the height of the tree at (r, c) to the digit ht, then redoes
+     * row r and column c.
+     */
+    void setHeight(int r, int c, char ht)
+    {
+        if (r < 0 || r >= forest.rows || c < 0 || c >= forest.cols || ht < '0' || ht > '9') {
+            cout << "Bad edit: " << r << "-" << c << " to " << ht << endl;
+            exit(0);
+        }
+        if (forest.heights[at(r, c)] == ht)
+            return;
+
+        forest.heights[at(r, c)] = ht;
+        forest.transposed[atT(r, c)] = ht;
+
+        // Take the old trees out of the count before their halves change
+        for (int cc = 0; cc < forest.cols; ++cc) {
+            numVisible -= isVisible(r, cc);
+        }
+        for (int rr = 0; rr < forest.rows; ++rr) {
+            if (rr != r)
+                numVisible -= isVisible(rr, c);
+        }
 
-	    cout << "coord " << r << ", " << c << " is NOT VISIBLE" << endl;
+        sweepRow(r);
+        sweepColumn(c);
+
+        for (int cc = 0; cc < forest.cols; ++cc) {
+            rescore(r, cc);
+        }
+        for (int rr = 0; rr < forest.rows; ++rr) {
+            if (rr != r)
+                rescore(rr, c);
         }
+
+        for (size_t b = at(r, 0) / SCORE_BLOCK; b <= at(r, forest.cols - 1) / SCORE_BLOCK; ++b) {
+            rescanBlock(b);
+        }
+        updateColumn(r, c);
     }
 
-    cout << "Total visible is " << visible << endl;
+    bool isVisible(int r, int c) const
+    {
+        return visAcross[atT(r, c)] | visUpDown[at(r, c)];
+    }
+
+    long long scenicScore(int r, int c) const
+    {
+        return score[at(r, c)];
+    }
+
+    long long visibleCount() const
+    {
+        return numVisible;
+    }
+
+    /**
+     * The most scenic tree, earliest in row-major order on a tie.
+     */
+    ScenicTree mostScenic() const
+    {
+        if (score.empty())
+            return ScenicTree{ 0, -1, -1 };
+        size_t pos = best[1];
+        return ScenicTree{ score[pos], (int)(pos / forest.cols), (int)(pos % forest.cols) };
+    }
+
+    const Forest& current() const
+    {
+        return forest;
+    }
+};
+
+/**
+ * Part 1: Calculates and prints the number of visible trees in the grid.
+ * Visibility is determined by checking each tree's height against other trees
+ * in the same row and column. Trees are considered visible if no other tree
+ * of equal or greater height blocks them when viewed from the grid's edges.
+ */
+void day8_part1()
+{
+    Forest forest = loadForest("trees.txt");
+    cout << "Total visible is " << countVisible(forest) << endl;
 }
 
 /**
@@ -124,83 +665,60 @@ void day8_part1()
  */
 void day8_part2()
 {
-    string s;
-    string q;
+    Forest forest = loadForest("trees.txt");
+    vector<ScenicTree> best = topScenic(scenicScores(forest), forest.cols, 1);
+    if (best.empty())
+        return;
 
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
-    ifstream in;
-    in.open("trees.txt");
-
-    vector<string> trees;
-    while (getline(in, s)) {
-        trees.push_back(s);
-    }
-
-    vector<pair<string, int>*> scores;
-
-    int numLines = trees.size();
-    int visible = 0;
-    for (int r = 0; r < numLines; ++r) {
-        string row = trees[r];
-        cout << row << endl;
-        for (int c = 0; c < row.length(); ++c) {
-            char ht = row[c];
-            //cout << "Checking r=" << r << ", c=" << c << " ht is " << ht << endl;
-
-            int leftCount = 0;
-            for (int left = c - 1; left >= 0; --left) {
-                //cout << "    left chk, left = " << left << ", ht = " << ht << ", tree = " << row[left] << endl;
-		++leftCount;
-                if (row[left] >= ht) {
-                    break;
-                }
-            }
-
-            int rightCount = 0;
-            for (int right = c + 1; right < row.length(); ++right) {
-                ++rightCount;
-                if (row[right] >= ht) {
-                    break;
-                }
-            }
+    cout << "Best score: " << best[0].score << ", key is " << best[0].row << "-" << best[0].col << endl;
+}
 
-            int upCount = 0;
-            for (int up = r - 1; up >= 0; --up) {
-                ++upCount;
-                if (trees[up][c] >= ht) {
-                    break;
-                }
-            }
+/**
+ * Prints the k most scenic trees, best first, with timing.
+ */
+void day8_top(size_t k)
+{
+    Forest forest = loadForest("trees.txt");
 
-            int downCount = 0;
-            for (int down = r + 1; down < numLines; ++down) {
-                //cout << "    down chk, down = " << down << ", ht = " << ht << ", tree = " << trees[down][c] << endl;
-                ++downCount;
-                if (trees[down][c] >= ht) {
-                    break;
-                }
-            }
+    auto t1 = Clock::now();
+    vector<ScenicTree> best = topScenic(scenicScores(forest), forest.cols, k);
+    auto t2 = Clock::now();
 
-            cout << "left = " << leftCount << ", right = " << rightCount << ", up = " << upCount << ", down = " << downCount << endl;
-            int score = leftCount * rightCount * upCount * downCount;
-            cout << "coord " << r << ", " << c << " (" << row[c] << ") score is " << score << endl;
+    for (const ScenicTree& tree : best) {
+        cout << "Score: " << tree.score << ", key is " << tree.row << "-" << tree.col << endl;
+    }
+    cout << "Duration: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds" << endl;
+}
 
-            string key = to_string(r) + "-" + to_string(c);
+/**
+ * Applies numEdits random height changes through ForestEditor and prints the
+ * running aggregates at the end, next to a full recompute of the edited
+ * forest as a cross-check.
+ */
+void day8_edits(int numEdits)
+{
+    ForestEditor editor(loadForest("trees.txt"));
+    const Forest& forest = editor.current();
+    if (forest.rows == 0)
+        return;
 
-            //pair<string, int> p = new pair<string, int>(key, score);
-            auto *p = new pair<string, int>(key, score);
-            scores.push_back(p);
-        }
+    mt19937 rng(2022);
+    auto t1 = Clock::now();
+    for (int i = 0; i < numEdits; ++i) {
+        int r = rng() % forest.rows;
+        int c = rng() % forest.cols;
+        editor.setHeight(r, c, (char)('0' + rng() % HEIGHTS));
     }
+    auto t2 = Clock::now();
 
-    sort(scores.begin(), scores.end(), [](pair<string, int>* a, pair<string, int>* b) {
-	return a->second < b->second;
-    });
+    ScenicTree best = editor.mostScenic();
+    cout << "After " << numEdits << " edits: visible " << editor.visibleCount()
+        << ", best score: " << best.score << ", key is " << best.row << "-" << best.col << endl;
+    cout << "Duration: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds" << endl;
 
-    for (auto p : scores) {
-	cout << "Score: " << p->second << ", key is " << p->first << endl;
-	//cout << "Score: " << p->second << ", key is " << p->first << end;
-    }
+    vector<ScenicTree> full = topScenic(scenicScores(forest), forest.cols, 1);
+    cout << "Full recompute: visible " << countVisible(forest)
+        << ", best score: " << full[0].score << ", key is " << full[0].row << "-" << full[0].col << endl;
 }
 
 int main()
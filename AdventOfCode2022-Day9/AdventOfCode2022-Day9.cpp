@@ -14,212 +14,442 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <set>
 #include <algorithm>
-#include <map>
-#include <regex>
-#include <queue>
+#include <unordered_map>
+#include <cstdint>
+#include <chrono>
+#include <bitset>
 
 using namespace std;
 
-enum entry_type { DirType, FileType };
-
-std::vector<std::string> str_split(const std::string& s, const char* pattern) {
-    std::regex sep_regex = std::regex{ pattern };
-    std::sregex_token_iterator iter(s.begin(), s.end(), sep_regex, -1);
-    std::sregex_token_iterator end;
-    return { iter, end };
-}
+typedef chrono::high_resolution_clock Clock;
 
 int sgn(int val) {
     return (0 < val) - (val < 0);
 }
 
 /**
- * Part 1: Simulate the movement of a rope with two knots (head and tail)
- * based on a series of given directions and distances. It calculates the
- * number of unique positions that the tail of the rope occupies at least once.
+ * Number of set bits. std::bitset keeps this portable to 32-bit builds and
+ * CPUs without POPCNT; compilers still emit the instruction when the target
+ * allows it.
  */
-void part1()
+inline int popCount(uint64_t bits)
 {
-    string s;
-    string q;
+    return (int)bitset<64>(bits).count();
+}
 
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
-    ifstream in;
-    in.open("movesx.txt");
+struct Move {
+    int dx;
+    int dy;
+    int dist;
+};
 
-    map<string, bool> check;
+/**
+ * Reads the head's moves, one "<L|R|U|D> <dist>" per line. Up is -y, as in
+ * the original simulation.
+ */
+vector<Move> loadMoves(const string& filename)
+{
+    string s;
+    ifstream in;
+    in.open(filename);
 
-    int hx = 1, hy = 5, tx = 1, ty = 5;
+    vector<Move> moves;
     while (getline(in, s)) {
-        cout << s << endl;
-
-        vector<string> tokens = str_split(s, " ");
-        char cmd = tokens[0][0];
-        int dist = stoi(tokens[1]);
-
-        for (int i = 0; i < dist; ++i) {
-	    switch (cmd) {
-	    case 'L':
-                --hx;
-		break;
-	    case 'R':
-                ++hx;
-		break;
-	    case 'U':
-                --hy;
-		break;
-	    case 'D':
-                ++hy;
-		break;
-	    default:
-		cout << "BAD";
-		exit(0);
-	    }
-
-            // Update the tail
-            int dx = abs(hx - tx);
-            int dy = abs(hy - ty);
-            int sx = sgn(hx - tx);
-            int sy = sgn(hy - ty);
-
-            if (dx > 0 && dy > 1 || dy > 0 && dx > 1) {
-                // Need diagonal move
-
-                tx += sx;
-                ty += sy;
-
-            } else if (dx > 1) {
-                // Need x move
-
-                tx += sx;
-            } else if (dy > 1) {
-                // Need y move
-
-                ty += sy;
+        if (!s.empty() && s.back() == '\r')
+            s.pop_back();
+        if (s.empty())
+            continue;
+
+        Move mv = { 0, 0, 0 };
+        switch (s[0]) {
+        case 'L':
+            mv.dx = -1;
+            break;
+        case 'R':
+            mv.dx = 1;
+            break;
+        case 'U':
+            mv.dy = -1;
+            break;
+        case 'D':
+            mv.dy = 1;
+            break;
+        default:
+            cout << "BAD: " << s << endl;
+            exit(0);
+        }
+
+        size_t pos = 1;
+        while (pos < s.length() && s[pos] == ' ')
+            ++pos;
+        if (pos == s.length() || s[pos] < '0' || s[pos] > '9') {
+            cout << "BAD: " << s << endl;
+            exit(0);
+        }
+        for (; pos < s.length() && s[pos] >= '0' && s[pos] <= '9'; ++pos) {
+            mv.dist = mv.dist * 10 + (s[pos] - '0');
+        }
+        moves.push_back(mv);
+    }
+    return moves;
+}
+
+/**
+ * Set of grid cells, kept as 64x64 bitmap tiles that are created the first
+ * time something lands in them. Tiles are found through a hash keyed on the
+ * tile's packed coordinates, with the last tile used cached since a rope
+ * mostly lands next to where it just was. Any int coordinate works, so there
+ * is no starting offset to pick, and the count is a popcount over the tiles.
+ */
+class VisitedCells {
+private:
+    static const int TILE_BITS = 6;
+    static const int TILE_MASK = (1 << TILE_BITS) - 1;
+
+    struct Tile {
+        uint64_t rows[1 << TILE_BITS];
+    };
+
+    unordered_map<uint64_t, size_t> index;
+    vector<Tile> tiles;
+    uint64_t lastKey = ~0ull;
+    size_t lastTile = 0;
+
+    Tile& tileFor(int x, int y)
+    {
+        // Arithmetic shift, so negative cells land in negative tiles
+        uint64_t key = (uint64_t)(uint32_t)(x >> TILE_BITS) << 32 | (uint32_t)(y >> TILE_BITS);
+        if (key != lastKey) {
+            auto found = index.find(key);
+            if (found == index.end()) {
+                found = index.emplace(key, tiles.size()).first;
+                tiles.push_back(Tile());
             }
+            lastKey = key;
+            lastTile = found->second;
+        }
+        return tiles[lastTile];
+    }
 
-            string key = to_string(tx) + " " + to_string(ty);
-            check[key] = true;
+public:
+    void insert(int x, int y)
+    {
+        tileFor(x, y).rows[y & TILE_MASK] |= 1ull << (x & TILE_MASK);
+    }
 
-	    cout << "   " << i << ": HEAD: [" << hx << ", " << hy << "] TAIL : [" << tx << ", " << ty << "] " << endl;
-	}
+    /**
+     * Inserts len cells in a line: (x, y), then stepping by (dx, dy). Runs
+     * along a row or column are split at tile edges and each piece looks up
+     * its tile once: a row piece is a single OR, a column piece one OR per
+     * row. Diagonal runs go a cell at a time.
+     */
+    void insertRun(int x, int y, int dx, int dy, int len)
+    {
+        if (len <= 0)
+            return;
+        if (dx != 0 && dy != 0) {
+            for (int i = 0; i < len; ++i) {
+                insert(x + i * dx, y + i * dy);
+            }
+            return;
+        }
+
+        bool across = dy == 0;
+        int start = across ? x : y;
+        int step = across ? dx : dy;
+        int lo = step >= 0 ? start : start - (len - 1);
+        int hi = lo + (len - 1);
+        for (;;) {
+            int end = min(hi, lo | TILE_MASK);
+            if (across) {
+                int width = end - lo + 1;
+                uint64_t bits = width == 64 ? ~0ull : (1ull << width) - 1;
+                tileFor(lo, y).rows[y & TILE_MASK] |= bits << (lo & TILE_MASK);
+            } else {
+                Tile& tile = tileFor(x, lo);
+                uint64_t bit = 1ull << (x & TILE_MASK);
+                for (int row = lo & TILE_MASK; row <= (end & TILE_MASK); ++row) {
+                    tile.rows[row] |= bit;
+                }
+            }
+            if (end == hi)
+                break;
+            lo = end + 1;
+        }
     }
 
-    int size = check.size();
-    cout << "size is " << size;
-}
+    size_t count() const
+    {
+        size_t total = 0;
+        for (const Tile& tile : tiles) {
+            for (uint64_t row : tile.rows) {
+                total += popCount(row);
+            }
+        }
+        return total;
+    }
+};
 
 /**
- * part2 - This method extends the rope simulation from part1 to include a rope
- * consisting of ten knots. The head of the rope moves according to a series
- * of commands, and each subsequent knot follows the preceding knot using
- * the same movement rules.
+ * Moves a knot one step toward the knot ahead of it if they're no longer
+ * touching: straight along a row or column, or diagonally if they're in
+ * neither. Returns whether the knot moved.
  */
-void part2()
+bool follow(int hx, int hy, int& tx, int& ty)
 {
-    string s;
-    string q;
+    if (abs(hx - tx) <= 1 && abs(hy - ty) <= 1)
+        return false;
 
-    //istringstream in("mjqjpqmgbljsphdztnvjfqwrcgsmlb");
-    ifstream in;
-    in.open("moves.txt");
-
-    //map<string, bool> check;
-    set<string> check;
-
-    int init_x = 30;
-    int init_y = 50;
+    tx += sgn(hx - tx);
+    ty += sgn(hy - ty);
+    return true;
+}
 
-    int hx = init_x;
-    int hy = init_y;
+struct Point {
+    int x;
+    int y;
+};
 
-    int tails_x[9];
-    int tails_y[9];
-    for (int i = 0; i < 9; ++i) {
-        tails_x[i] = init_x;
-        tails_y[i] = init_y;
+/**
+ * A rope of any number of knots, the head first. Each step drags the knots
+ * behind the head along in order, and stops at the first knot that stays
+ * put, since nothing behind it has anything new to follow.
+ */
+class Rope {
+private:
+    vector<Point> knots;
+    vector<int> joinedAt;
+
+public:
+    Rope(int numKnots)
+        : knots(max(numKnots, 1), Point{ 0, 0 }), joinedAt(knots.size())
+    {
     }
 
-    while (getline(in, s)) {
-        cout << s << endl;
-
-        vector<string> tokens = str_split(s, " ");
-        char cmd = tokens[0][0];
-        int dist = stoi(tokens[1]);
-
-        for (int i = 0; i < dist; ++i) {
-	    switch (cmd) {
-	    case 'L':
-                --hx;
-		break;
-	    case 'R':
-                ++hx;
-		break;
-	    case 'U':
-                --hy;
-		break;
-	    case 'D':
-                ++hy;
-		break;
-	    default:
-		cout << "BAD";
-		exit(0);
-	    }
-
-            int cur_hx = hx;
-            int cur_hy = hy;
-
-            // Update the tails
-            for (int t = 0; t < 9; ++t) {
-                int tx = tails_x[t];
-                int ty = tails_y[t];
-                //cout << "    TAIL " << t << " IS [" << tx << ", " << ty << "], HEAD IS [" << cur_hx << ", " << cur_hy << "]" << endl;
-
-                int dx = abs(cur_hx - tx);
-                int dy = abs(cur_hy - ty);
-                int sx = sgn(cur_hx - tx);
-                int sy = sgn(cur_hy - ty);
-
-                if (dx > 0 && dy > 1 || dy > 0 && dx > 1) {
-                    // Need diagonal move
-
-                    tx += sx;
-                    ty += sy;
+    /**
+     * Moves the head one cell by (dx, dy). Returns how many knots behind the
+     * head moved; they're always the ones right behind it.
+     */
+    int step(int dx, int dy)
+    {
+        knots[0].x += dx;
+        knots[0].y += dy;
+
+        int numKnots = knots.size();
+        int k = 1;
+        while (k < numKnots && follow(knots[k - 1].x, knots[k - 1].y, knots[k].x, knots[k].y)) {
+            ++k;
+        }
+        return k - 1;
+    }
 
+    /**
+     * Moves the head dist cells by (dx, dy). For every knot that moves,
+     * calls record(k, first, count): knot k landed on first and the
+     * count - 1 cells after it in the (dx, dy) direction.
+     *
+     * The knots that have lined up straight behind the head, each one cell
+     * back along (dx, dy), move one cell every step from then on. They're
+     * left where they were when they lined up and caught up in bulk at the
+     * end of the move, each handing in a single run. Per step only the knots
+     * behind that straight stretch are simulated, and once the whole rope
+     * is straight the rest of the move costs nothing. A long move costs
+     * O(knots) plus the steps it takes to straighten out, instead of
+     * O(dist * knots).
+     */
+    template <typename Record>
+    void move(int dx, int dy, int dist, Record record)
+    {
+        int numKnots = knots.size();
+        int straight = 1;
+        joinedAt[0] = 0;
+
+        for (int i = 1; i <= dist && straight < numKnots; ++i) {
+            for (int k = straight; k < numKnots; ++k) {
+                Point ahead = knots[k - 1];
+                if (k == straight) {
+                    ahead.x += (i - joinedAt[k - 1]) * dx;
+                    ahead.y += (i - joinedAt[k - 1]) * dy;
                 }
-                else if (dx > 1) {
-                    // Need x move
+                if (!follow(ahead.x, ahead.y, knots[k].x, knots[k].y))
+                    break;
 
-                    tx += sx;
+                record(k, knots[k], 1);
+                if (k == straight && knots[k].x == ahead.x - dx && knots[k].y == ahead.y - dy) {
+                    joinedAt[k] = i;
+                    ++straight;
                 }
-                else if (dy > 1) {
-                    // Need y move
+            }
+        }
+
+        for (int k = 0; k < straight; ++k) {
+            int steps = dist - joinedAt[k];
+            if (steps == 0)
+                continue;
+            record(k, Point{ knots[k].x + dx, knots[k].y + dy }, steps);
+            knots[k].x += steps * dx;
+            knots[k].y += steps * dy;
+        }
+    }
 
-                    ty += sy;
-                }
+    const Point& knot(int k) const
+    {
+        return knots[k];
+    }
 
-                tails_x[t] = tx;
-                tails_y[t] = ty;
-                //cout << "    TAIL " << t << " IS NOW [" << tx << ", " << ty << "]" << endl;
+    const Point& tail() const
+    {
+        return knots.back();
+    }
 
-                //cout << "   " << i << ": HEAD: [" << cur_hx << ", " << cur_hy << "] TAIL : [" << tx << ", " << ty << "] " << endl;
+    int size() const
+    {
+        return knots.size();
+    }
+};
 
-                cur_hx = tx;
-                cur_hy = ty;
-            }
+/**
+ * Runs the moves on a rope of numKnots knots and returns how many cells the
+ * tail visited, counting where it started.
+ */
+size_t countTailVisited(const vector<Move>& moves, int numKnots)
+{
+    Rope rope(numKnots);
+    int lastKnot = rope.size() - 1;
 
-	    string key = to_string(tails_x[8]) + " " + to_string(tails_y[8]);
-	    //check[key] = true;
-            check.insert(key);
+    VisitedCells check;
+    check.insert(rope.tail().x, rope.tail().y);
 
-            cout << "TAIL WAS: " << key << endl;
-	}
+    for (const Move& mv : moves) {
+        rope.move(mv.dx, mv.dy, mv.dist, [&](int k, Point first, int count) {
+            if (k == lastKnot)
+                check.insertRun(first.x, first.y, mv.dx, mv.dy, count);
+        });
     }
+    return check.count();
+}
+
+/**
+ * Runs the moves once on a rope of numKnots knots, tracking the cells every
+ * knot visited at the same time. Entry k is knot k's count, the head being
+ * knot 0. Only knots that moved get recorded; a knot that stayed put is
+ * already in its set.
+ *
+ * Moves normally go through move(), which advances the straightened part
+ * of the rope in bulk. With bulk off every cell of every move is a step(),
+ * which is slower but simple enough to serve as the reference.
+ */
+vector<size_t> countAllVisited(const vector<Move>& moves, int numKnots, bool bulk = true)
+{
+    Rope rope(numKnots);
+    vector<VisitedCells> check(rope.size());
+    for (int k = 0; k < rope.size(); ++k) {
+        check[k].insert(rope.knot(k).x, rope.knot(k).y);
+    }
+
+    for (const Move& mv : moves) {
+        if (bulk) {
+            rope.move(mv.dx, mv.dy, mv.dist, [&](int k, Point first, int count) {
+                check[k].insertRun(first.x, first.y, mv.dx, mv.dy, count);
+            });
+            continue;
+        }
+
+        for (int i = 0; i < mv.dist; ++i) {
+            int moved = rope.step(mv.dx, mv.dy);
+            for (int k = 0; k <= moved; ++k) {
+                check[k].insert(rope.knot(k).x, rope.knot(k).y);
+            }
+        }
+    }
+
+    vector<size_t> counts;
+    for (const VisitedCells& cells : check) {
+        counts.push_back(cells.count());
+    }
+    return counts;
+}
+
+/**
+ * Part 1: Simulate the movement of a rope with two knots (head and tail)
+ * based on a series of given directions and distances. It calculates the
+ * number of unique positions that the tail of the rope occupies at least once.
+ */
+void part1()
+{
+    vector<Move> moves = loadMoves("moves.txt");
+    cout << "size is " << countTailVisited(moves, 2) << endl;
+}
+
+/**
+ * part2 - This method extends the rope simulation from part1 to include a rope
+ * consisting of ten knots. The head of the rope moves according to a series
+ * of commands, and each subsequent knot follows the preceding knot using
+ * the same movement rules.
+ */
+void part2()
+{
+    vector<Move> moves = loadMoves("moves.txt");
+    cout << "size is " << countTailVisited(moves, 10) << endl;
+}
 
-    int size = check.size();
-    cout << "size is " << size;
+/**
+ * Runs the moves on a rope of numKnots knots and prints the tail's visited
+ * count with timing.
+ */
+void day9_rope(int numKnots)
+{
+    vector<Move> moves = loadMoves("moves.txt");
+
+    auto t1 = Clock::now();
+    size_t visited = countTailVisited(moves, numKnots);
+    auto t2 = Clock::now();
+
+    cout << numKnots << " knots: size is " << visited << endl;
+    cout << "Duration: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds" << endl;
+}
+
+/**
+ * Both parts from a single pass: on a ten knot rope, knot 1 moves exactly
+ * like the tail of the two knot rope, and knot 9 is the part 2 tail.
+ */
+void day9_all()
+{
+    vector<Move> moves = loadMoves("moves.txt");
+
+    auto t1 = Clock::now();
+    vector<size_t> counts = countAllVisited(moves, 10);
+    auto t2 = Clock::now();
+
+    cout << "Part 1 size is " << counts[1] << endl;
+    cout << "Part 2 size is " << counts[9] << endl;
+    cout << "Duration: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds" << endl;
+}
+
+/**
+ * Cross-checks the bulk engine against plain stepping on a rope of
+ * numKnots knots: every knot's visited count has to agree. Prints the
+ * number of knots that differ and both timings.
+ */
+void day9_check(int numKnots)
+{
+    vector<Move> moves = loadMoves("moves.txt");
+
+    auto t1 = Clock::now();
+    vector<size_t> bulk = countAllVisited(moves, numKnots);
+    auto t2 = Clock::now();
+    vector<size_t> stepped = countAllVisited(moves, numKnots, false);
+    auto t3 = Clock::now();
+
+    int mismatches = 0;
+    for (size_t k = 0; k < bulk.size(); ++k) {
+        if (bulk[k] != stepped[k])
+            ++mismatches;
+    }
+    cout << mismatches << " of " << bulk.size() << " knots differ" << endl;
+    cout << "Bulk: " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << " milliseconds, stepped: "
+        << chrono::duration_cast<chrono::milliseconds>(t3 - t2).count() << " milliseconds" << endl;
 }
 
 int main()